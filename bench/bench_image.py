@@ -0,0 +1,69 @@
+import io
+import pytest
+import numpy as np
+
+from pywuffs import *
+from pywuffs.aux import *
+
+from conftest import IMAGE_SIZES, GENERATED_IMAGE_FORMATS, STATIC_IMAGES
+
+IMAGE_CASES = [(f, s) for f in GENERATED_IMAGE_FORMATS for s in IMAGE_SIZES] + [(f, None) for f in STATIC_IMAGES]
+PIXEL_FORMATS = [
+    PixelFormat.BGR_565,
+    PixelFormat.BGR,
+    PixelFormat.BGRA_NONPREMUL,
+    PixelFormat.BGRA_NONPREMUL_4X16LE,
+    PixelFormat.BGRA_PREMUL,
+    PixelFormat.RGBA_NONPREMUL,
+    PixelFormat.RGBA_PREMUL,
+]
+
+
+def get_image(image_corpus, case):
+    if case not in image_corpus:
+        pytest.skip("Pillow is needed for generating %s images" % case[0])
+    return image_corpus[case]
+
+
+def case_id(case):
+    return "%s-%s" % (case[0], case[1] or "static")
+
+
+@pytest.mark.parametrize("case", IMAGE_CASES, ids=case_id)
+def test_pywuffs(benchmark, measure, image_corpus, case):
+    benchmark.group = "image-%s" % case_id(case)
+    data = get_image(image_corpus, case)
+    config = ImageDecoderConfig()
+    config.enabled_decoders = [getattr(ImageDecoderType, case[0])]
+    decoder = ImageDecoder(config)
+    result = measure(lambda: decoder.decode(data), len(data))
+    assert len(result.error_message) == 0
+
+
+@pytest.mark.parametrize("pixel_format", PIXEL_FORMATS, ids=lambda pf: pf.name)
+@pytest.mark.parametrize("case", [("PNG", 512), ("JPEG", 512)], ids=case_id)
+def test_pywuffs_pixel_format(benchmark, measure, image_corpus, case, pixel_format):
+    benchmark.group = "image-%s-pixel-format" % case_id(case)
+    data = get_image(image_corpus, case)
+    config = ImageDecoderConfig()
+    config.pixel_format = pixel_format
+    decoder = ImageDecoder(config)
+    result = measure(lambda: decoder.decode(data), len(data))
+    assert len(result.error_message) == 0
+
+
+@pytest.mark.parametrize("case", [c for c in IMAGE_CASES if c[1] is not None], ids=case_id)
+def test_pil(benchmark, measure, image_corpus, case):
+    Image = pytest.importorskip("PIL.Image")
+    benchmark.group = "image-%s" % case_id(case)
+    data = get_image(image_corpus, case)
+    measure(lambda: np.asarray(Image.open(io.BytesIO(data)).convert("RGBA")), len(data))
+
+
+@pytest.mark.parametrize("case", [c for c in IMAGE_CASES if c[1] is not None and c[0] != "GIF"], ids=case_id)
+def test_opencv(benchmark, measure, image_corpus, case):
+    cv2 = pytest.importorskip("cv2")
+    benchmark.group = "image-%s" % case_id(case)
+    data = get_image(image_corpus, case)
+    result = measure(lambda: cv2.imdecode(np.frombuffer(data, np.uint8), cv2.IMREAD_UNCHANGED), len(data))
+    assert result is not None
@@ -0,0 +1,51 @@
+import json
+import pytest
+
+from pywuffs import *
+from pywuffs.aux import *
+
+from conftest import JSON_SHAPES
+
+
+@pytest.mark.parametrize("shape", JSON_SHAPES)
+def test_pywuffs(benchmark, measure, json_corpus, shape):
+    benchmark.group = "json-%s" % shape
+    data = json_corpus[shape]
+    decoder = JsonDecoder(JsonDecoderConfig())
+    result = measure(lambda: decoder.decode(data), len(data))
+    assert len(result.error_message) == 0
+
+
+@pytest.mark.parametrize("shape", ["numeric"])
+def test_pywuffs_numeric_arrays(benchmark, measure, json_corpus, shape):
+    benchmark.group = "json-%s" % shape
+    data = json_corpus[shape]
+    config = JsonDecoderConfig()
+    config.numeric_array_max_ndim = 2
+    decoder = JsonDecoder(config)
+    result = measure(lambda: decoder.decode(data), len(data))
+    assert len(result.error_message) == 0
+
+
+@pytest.mark.parametrize("shape", JSON_SHAPES)
+def test_pywuffs_validate(benchmark, measure, json_corpus, shape):
+    benchmark.group = "json-%s" % shape
+    data = json_corpus[shape]
+    decoder = JsonDecoder(JsonDecoderConfig())
+    result = measure(lambda: decoder.validate(data), len(data))
+    assert len(result.error_message) == 0
+
+
+@pytest.mark.parametrize("shape", JSON_SHAPES)
+def test_json(benchmark, measure, json_corpus, shape):
+    benchmark.group = "json-%s" % shape
+    data = json_corpus[shape]
+    measure(lambda: json.loads(data), len(data))
+
+
+@pytest.mark.parametrize("shape", JSON_SHAPES)
+def test_orjson(benchmark, measure, json_corpus, shape):
+    orjson = pytest.importorskip("orjson")
+    benchmark.group = "json-%s" % shape
+    data = json_corpus[shape]
+    measure(lambda: orjson.loads(data), len(data))
@@ -0,0 +1,132 @@
+import io
+import os
+import json
+import tracemalloc
+import pytest
+import numpy as np
+
+# The corpus is generated deterministically, so that the results of different
+# runs (and machines) are comparable.
+SEED = 1234
+IMAGE_SIZES = [64, 512, 2048]
+IMAGES_PATH = os.path.join(os.path.dirname(os.path.realpath(__file__)), "..", "test", "images")
+# Formats which can't be generated with Pillow are taken from the test images
+STATIC_IMAGES = {
+    "NIE": "hippopotamus.nie",
+    "WBMP": "lena.wbmp",
+    "QOI": "lena.qoi",
+    "ETC2": "bricks-color.etc2.pkm",
+    "TH": "1QcSHQRnh493V4dIh4eXh1h4kJUI.th",
+}
+GENERATED_IMAGE_FORMATS = ["PNG", "BMP", "TGA", "GIF", "JPEG", "WEBP"]
+
+
+def generate_image(size):
+    # Smooth gradients with some noise, which compress similarly to photos
+    rng = np.random.default_rng(SEED + size)
+    y, x = np.mgrid[0:size, 0:size].astype(np.float32) / size
+    channels = [np.sin(6 * x + 2 * y), np.cos(5 * y - 3 * x), np.sin(4 * (x + y) ** 2)]
+    image = np.stack(channels, axis=-1) * 100 + 128 + rng.normal(0, 8, (size, size, 3))
+    return np.clip(image, 0, 255).astype(np.uint8)
+
+
+def encode_image(image, image_format):
+    from PIL import Image
+    pil_image = Image.fromarray(image)
+    if image_format == "GIF":
+        pil_image = pil_image.quantize(256)
+    buffer = io.BytesIO()
+    pil_image.save(buffer, format=image_format)
+    return buffer.getvalue()
+
+
+@pytest.fixture(scope="session")
+def image_corpus():
+    """Dict mapping (format, size) to encoded images, size being None for the static images."""
+    corpus = {}
+    try:
+        for size in IMAGE_SIZES:
+            image = generate_image(size)
+            for image_format in GENERATED_IMAGE_FORMATS:
+                corpus[(image_format, size)] = encode_image(image, image_format)
+    except ImportError:
+        pass
+    for image_format, file_name in STATIC_IMAGES.items():
+        with open(os.path.join(IMAGES_PATH, file_name), "rb") as f:
+            corpus[(image_format, None)] = f.read()
+    return corpus
+
+
+def generate_json(shape):
+    rng = np.random.default_rng(SEED)
+    if shape == "deep":
+        document = 0
+        for i in range(200):
+            document = {"level": i, "child": [document]}
+        return [document] * 20
+    elif shape == "wide":
+        return {"key_%d" % i: i for i in range(100000)}
+    elif shape == "numeric":
+        return rng.normal(0, 1e6, (2000, 100)).tolist()
+    elif shape == "string":
+        words = ["wuffs", "json", "été", "quote\"d", "tab\t", "\U0001F600"]
+        return [" ".join(rng.choice(words, 50)) for _ in range(20000)]
+    elif shape == "records":
+        return [{"id": i, "name": "name%d" % i, "score": float(i) / 7, "ok": bool(i % 2), "tags": ["a", "b"]}
+                for i in range(50000)]
+    raise ValueError(shape)
+
+
+JSON_SHAPES = ["deep", "wide", "numeric", "string", "records"]
+
+
+@pytest.fixture(scope="session")
+def json_corpus():
+    """Dict mapping shape names to encoded JSON documents."""
+    return {shape: json.dumps(generate_json(shape)).encode("utf-8") for shape in JSON_SHAPES}
+
+
+def call_peak_rss_bytes(func):
+    """Calls func and returns the peak RSS during the call, None if it can't be measured. The peak is reset before the
+    call, so that it doesn't carry over from the previous (possibly bigger) cases. Linux only."""
+    try:
+        # Resets VmHWM to the current RSS
+        with open("/proc/self/clear_refs", "w") as f:
+            f.write("5")
+    except OSError:
+        return None
+    func()
+    with open("/proc/self/status") as f:
+        for line in f:
+            if line.startswith("VmHWM:"):
+                return int(line.split()[1]) * 1024
+    return None
+
+
+@pytest.fixture
+def measure(benchmark):
+    """Benchmarks func and reports in the extra_info of the benchmark (see --benchmark-json) the throughput, the
+    latency percentiles, the peak RSS of a single call and the peak Python heap allocations of a single call. The
+    latter is traced with tracemalloc, which only sees the allocations made through the Python allocators (e.g. the
+    Python objects and NumPy arrays), not the native buffers of pywuffs, Pillow or OpenCV."""
+
+    def run(func, num_bytes, num_items=1):
+        result = benchmark(func)
+        benchmark.extra_info["peak_rss_bytes"] = call_peak_rss_bytes(func)
+        tracemalloc.start()
+        func()
+        benchmark.extra_info["peak_python_heap_bytes"] = tracemalloc.get_traced_memory()[1]
+        tracemalloc.stop()
+        stats = getattr(benchmark, "stats", None)
+        if stats is None:
+            # Benchmarking is disabled
+            return result
+        timings = np.array(stats.stats.data)
+        median = float(np.median(timings))
+        benchmark.extra_info["p50_latency_s"] = median
+        benchmark.extra_info["p99_latency_s"] = float(np.percentile(timings, 99))
+        benchmark.extra_info["mb_per_s"] = num_bytes / median / 1e6
+        benchmark.extra_info["items_per_s"] = num_items / median
+        return result
+
+    return run
@@ -0,0 +1,338 @@
+// Native micro-benchmark for the wrapper layers, without the Python
+// interpreter in the way. Usage:
+//
+//   pywuffs_bench [--iterations N] [--perf] FILE...
+//
+// Files ending with ".json" are decoded as JSON, the others as images. For
+// every file and phase, the median and minimum wall time per iteration are
+// reported, together with the hardware counters if --perf is given (Linux
+// only).
+
+#define WUFFS_IMPLEMENTATION
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "wuffs-aux-codecs.h"
+#include "wuffs-aux-image-wrapper.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Hardware counters of the calling thread: cycles, instructions and cache
+// misses, read as a group.
+class PerfCounters {
+ public:
+  static constexpr size_t kNumCounters = 3;
+
+  PerfCounters() {
+#if defined(__linux__)
+    const uint64_t configs[kNumCounters] = {PERF_COUNT_HW_CPU_CYCLES,
+                                            PERF_COUNT_HW_INSTRUCTIONS,
+                                            PERF_COUNT_HW_CACHE_MISSES};
+    for (size_t i = 0; i < kNumCounters; i++) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.disabled = (i == 0);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      fds_[i] = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds_[0], 0));
+      if (fds_[i] < 0) {
+        Close();
+        return;
+      }
+    }
+#endif
+  }
+
+  ~PerfCounters() { Close(); }
+
+  PerfCounters(const PerfCounters& other) = delete;
+  PerfCounters& operator=(const PerfCounters& other) = delete;
+
+  bool is_valid() const { return fds_[0] >= 0; }
+
+  void Start() {
+#if defined(__linux__)
+    ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+  }
+
+  // Stops counting and adds the counts to values.
+  void Stop(uint64_t* values) {
+#if defined(__linux__)
+    ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t data[kNumCounters + 1] = {};
+    if (read(fds_[0], data, sizeof(data)) == sizeof(data)) {
+      for (size_t i = 0; i < kNumCounters; i++) {
+        values[i] += data[i + 1];
+      }
+    }
+#endif
+  }
+
+ private:
+  void Close() {
+#if defined(__linux__)
+    for (int& fd : fds_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+      fd = -1;
+    }
+#endif
+  }
+
+  int fds_[kNumCounters] = {-1, -1, -1};
+};
+
+// Per-iteration measurements of a phase
+struct Phase {
+  std::vector<double> seconds;
+  uint64_t counters[PerfCounters::kNumCounters] = {};
+};
+
+using Phases = std::map<std::string, Phase>;
+
+// ImageDecoder which records the time spent before, in and after AllocPixbuf,
+// i.e. decoding the image header, allocating the pixel buffer and decoding
+// the pixels.
+class TimedImageDecoder : public wuffs_aux_wrap::ImageDecoder {
+ public:
+  explicit TimedImageDecoder(const wuffs_aux_wrap::ImageDecoderConfig& config)
+      : wuffs_aux_wrap::ImageDecoder(config) {}
+
+  AllocPixbufResult AllocPixbuf(const wuffs_base__image_config& image_config,
+                                bool allow_uninitialized_memory) override {
+    alloc_start_ = Clock::now();
+    AllocPixbufResult result = wuffs_aux_wrap::ImageDecoder::AllocPixbuf(
+        image_config, allow_uninitialized_memory);
+    alloc_end_ = Clock::now();
+    return result;
+  }
+
+  Clock::time_point alloc_start_;
+  Clock::time_point alloc_end_;
+};
+
+// DecodeJson callbacks which only count the values, so that the measured time
+// is the Wuffs tokenizing and number/string parsing
+class CountingJsonCallbacks : public wuffs_aux::DecodeJsonCallbacks {
+ public:
+  std::string AppendNull() override { return Count(); }
+  std::string AppendBool(bool) override { return Count(); }
+  std::string AppendI64(int64_t) override { return Count(); }
+  std::string AppendF64(double) override { return Count(); }
+  std::string AppendTextString(std::string&&) override { return Count(); }
+  std::string Push(uint32_t) override { return Count(); }
+  std::string Pop(uint32_t) override { return ""; }
+
+  uint64_t num_values = 0;
+
+ private:
+  std::string Count() {
+    num_values++;
+    return "";
+  }
+};
+
+std::string Measure(Phases& phases, const std::string& name,
+                    PerfCounters* perf, const std::function<std::string()>& f) {
+  if (perf) {
+    perf->Start();
+  }
+  const Clock::time_point start = Clock::now();
+  std::string error_message = f();
+  phases[name].seconds.push_back(SecondsSince(start));
+  if (perf) {
+    perf->Stop(phases[name].counters);
+  }
+  return error_message;
+}
+
+std::string BenchImage(const std::vector<uint8_t>& data, Phases& phases,
+                       PerfCounters* perf) {
+  TimedImageDecoder decoder((wuffs_aux_wrap::ImageDecoderConfig()));
+  const Clock::time_point start = Clock::now();
+  std::string error_message = Measure(phases, "image:total", perf, [&]() {
+    return decoder.Decode(data.data(), data.size()).error_message;
+  });
+  const Clock::time_point end = Clock::now();
+  if (error_message.empty()) {
+    using Seconds = std::chrono::duration<double>;
+    phases["image:header"].seconds.push_back(
+        Seconds(decoder.alloc_start_ - start).count());
+    phases["image:alloc_pixbuf"].seconds.push_back(
+        Seconds(decoder.alloc_end_ - decoder.alloc_start_).count());
+    phases["image:pixels"].seconds.push_back(
+        Seconds(end - decoder.alloc_end_).count());
+  }
+  return error_message;
+}
+
+std::string Tokenize(const std::vector<uint8_t>& data) {
+  static constexpr size_t kTokenBufferSize = 4096;
+  wuffs_json__decoder::unique_ptr decoder = wuffs_json__decoder::alloc();
+  if (!decoder) {
+    return "out of memory";
+  }
+  std::vector<wuffs_base__token> tokens(kTokenBufferSize);
+  wuffs_base__token_buffer tok_buf = wuffs_base__slice_token__writer(
+      wuffs_base__make_slice_token(tokens.data(), tokens.size()));
+  wuffs_base__io_buffer src = wuffs_base__ptr_u8__reader(
+      const_cast<uint8_t*>(data.data()), data.size(), true);
+  while (true) {
+    tok_buf.meta.ri = 0;
+    tok_buf.meta.wi = 0;
+    const wuffs_base__status status = decoder->decode_tokens(
+        &tok_buf, &src, wuffs_base__empty_slice_u8());
+    if (status.repr == nullptr) {
+      return "";
+    } else if (status.repr != wuffs_base__suspension__short_write) {
+      return status.message();
+    }
+  }
+}
+
+std::string BenchJson(const std::vector<uint8_t>& data, Phases& phases,
+                      PerfCounters* perf) {
+  std::string error_message = Measure(phases, "json:tokenize", perf, [&]() {
+    return Tokenize(data);
+  });
+  if (!error_message.empty()) {
+    return error_message;
+  }
+  return Measure(phases, "json:decode_json", perf, [&]() {
+    CountingJsonCallbacks callbacks;
+    wuffs_aux::sync_io::MemoryInput input(data.data(), data.size());
+    return wuffs_aux::DecodeJson(callbacks, input).error_message;
+  });
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>& data) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+  data.clear();
+  uint8_t chunk[64 * 1024];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  const bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+bool EndsWith(const std::string& s, const std::string& suffix) {
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void Report(const std::string& path, size_t size, Phases& phases,
+            bool with_counters) {
+  for (auto& phase : phases) {
+    std::vector<double>& seconds = phase.second.seconds;
+    if (seconds.empty()) {
+      continue;
+    }
+    std::sort(seconds.begin(), seconds.end());
+    const double median = seconds[seconds.size() / 2];
+    printf("%s %-20s median %10.3f ms  min %10.3f ms  %9.1f MB/s", path.c_str(),
+           phase.first.c_str(), median * 1e3, seconds[0] * 1e3,
+           size / median / 1e6);
+    if (with_counters && phase.second.counters[0] != 0) {
+      const uint64_t* counters = phase.second.counters;
+      const double n = static_cast<double>(seconds.size());
+      printf("  cycles %.0f  instructions %.0f  IPC %.2f  cache-misses %.0f",
+             counters[0] / n, counters[1] / n,
+             static_cast<double>(counters[1]) / counters[0], counters[2] / n);
+    }
+    printf("\n");
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t iterations = 100;
+  bool use_perf = false;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if ((arg == "--iterations") && (i + 1 < argc)) {
+      iterations = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--perf") {
+      use_perf = true;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    fprintf(stderr, "usage: %s [--iterations N] [--perf] FILE...\n", argv[0]);
+    return 1;
+  }
+
+  PerfCounters perf_counters;
+  PerfCounters* perf = nullptr;
+  if (use_perf) {
+    if (perf_counters.is_valid()) {
+      perf = &perf_counters;
+    } else {
+      fprintf(stderr, "hardware counters are not available\n");
+    }
+  }
+
+  int exit_code = 0;
+  for (const std::string& path : paths) {
+    Phases phases;
+    std::vector<uint8_t> data;
+    const Clock::time_point read_start = Clock::now();
+    if (!ReadFile(path, data)) {
+      fprintf(stderr, "%s: failed to read file\n", path.c_str());
+      exit_code = 1;
+      continue;
+    }
+    phases["read"].seconds.push_back(SecondsSince(read_start));
+    const bool is_json = EndsWith(path, ".json");
+    std::string error_message;
+    for (size_t i = 0; (i < iterations) && error_message.empty(); i++) {
+      error_message = is_json ? BenchJson(data, phases, perf)
+                              : BenchImage(data, phases, perf);
+    }
+    if (!error_message.empty()) {
+      fprintf(stderr, "%s: %s\n", path.c_str(), error_message.c_str());
+      exit_code = 1;
+      continue;
+    }
+    Report(path, data.size(), phases, perf != nullptr);
+  }
+  return exit_code;
+}
@@ -1,3 +1,4 @@
+import os
 from collections import defaultdict
 from setuptools import setup
 from pybind11.setup_helpers import Pybind11Extension
@@ -9,7 +10,10 @@ long_description = (Path(__file__).parent / "README.md").read_text()
 UNIX_BUILD_ARGS = ["-O3", "-g0", "-s", "--std=c++14",
                    "-fvisibility=hidden", "-flto", "-fno-fat-lto-objects"]
 BUILD_ARGS = defaultdict(lambda: UNIX_BUILD_ARGS)
-BUILD_ARGS["msvc"] = ["/O3", "/DNDEBUG", "/arch:AVX"]
+# Wuffs dispatches to its SIMD code paths at runtime (based on CPUID), but MSVC
+# only compiles the x86-64-v2 (SSE4.2) ones on opt-in
+BUILD_ARGS["msvc"] = ["/O3", "/DNDEBUG", "/arch:AVX",
+                      "/DWUFFS_CONFIG__ENABLE_MSVC_CPU_ARCH__X86_64_V2"]
 BUILD_ARGS["unix"] = UNIX_BUILD_ARGS
 
 UNIX_LINK_ARGS = ["-flto", "-fno-fat-lto-objects"]
@@ -19,6 +23,26 @@ LINK_ARGS["msvc"] = []
 LINK_ARGS["unix"] = UNIX_LINK_ARGS
 
 
+# Codecs which can be selected with the PYWUFFS_CODECS environment variable, a
+# comma-separated list (e.g. "png,jpeg,json"). All of them are compiled in if
+# it's not set. The Wuffs modules they depend on are selected in
+# src/wuffs-aux-codecs.h.
+ALL_CODECS = ["bmp", "gif", "nie", "png", "tga", "wbmp", "jpeg", "webp", "qoi",
+              "etc2", "th", "json", "cbor", "deflate", "gzip", "zlib", "bzip2",
+              "lzma", "xz", "crc32", "adler32", "xxhash32", "xxhash64",
+              "sha256"]
+
+
+def get_codec_macros():
+    codecs = [c.strip().lower() for c in os.environ.get("PYWUFFS_CODECS", "").split(",") if c.strip()]
+    if not codecs:
+        return []
+    unknown_codecs = [c for c in codecs if c not in ALL_CODECS]
+    if unknown_codecs:
+        raise ValueError("Unknown codecs in PYWUFFS_CODECS: " + ", ".join(unknown_codecs))
+    return [("PYWUFFS_CODECS", None)] + [("PYWUFFS_CODEC_" + c.upper(), None) for c in codecs]
+
+
 class CustomBuildExt(build_ext):
     def build_extensions(self):
         compiler = self.compiler.compiler_type
@@ -36,7 +60,8 @@ ext_modules = [
     Pybind11Extension(
         "pywuffs",
         ["src/wuffs-bindings.cpp"],
-        include_dirs=["libs/wuffs/release/c"]
+        include_dirs=["libs/wuffs/release/c"],
+        define_macros=get_codec_macros()
     ),
 ]
 
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/pytypes.h>
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "wuffs-aux-codecs.h"
+
+// This API wraps the wuffs_aux API for CBOR decoding the same way as
+// wuffs-aux-json-wrapper.h does for JSON.
+
+namespace wuffs_aux_wrap {
+
+// Tagged data item (RFC 8949, section 3.4) other than a typed array
+struct CborTag {
+  uint64_t tag;
+  pybind11::object value;
+};
+
+// Simple value (RFC 8949, section 3.3) other than false, true and null, e.g.
+// 23 for undefined
+struct CborSimpleValue {
+  uint8_t value;
+};
+
+struct CborDecoderConfig {
+  // If true, byte strings (except for map keys) are decoded into
+  // memoryviews, which wrap the decoded buffers without copying them
+  bool byte_string_views = true;
+  // If true, RFC 8746 typed arrays are decoded into 1D NumPy arrays, which
+  // wrap the decoded buffers without copying them
+  bool typed_arrays = true;
+};
+
+struct CborDecodingResult {
+  pybind11::object parsed;
+  std::string error_message;
+  uint64_t cursor_position = 0;
+
+  CborDecodingResult() = default;
+
+  CborDecodingResult(CborDecodingResult&& other) noexcept {
+    std::swap(parsed, other.parsed);
+    std::swap(error_message, other.error_message);
+    std::swap(cursor_position, other.cursor_position);
+  }
+
+  CborDecodingResult& operator=(CborDecodingResult&& other) noexcept {
+    if (this != &other) {
+      std::swap(parsed, other.parsed);
+      std::swap(error_message, other.error_message);
+      std::swap(cursor_position, other.cursor_position);
+    }
+    return *this;
+  }
+
+  CborDecodingResult(CborDecodingResult& other) = delete;
+  CborDecodingResult& operator=(CborDecodingResult& other) = delete;
+};
+
+struct CborDecoderError {
+  static const std::string DuplicateMapKey;
+  static const std::string UnhashableMapKey;
+  static const std::string BadDepth;
+  static const std::string FailedToOpenFile;
+  static const std::string BadInput;
+  static const std::string UnsupportedRecursionDepth;
+};
+
+const std::string CborDecoderError::DuplicateMapKey =
+    "wuffs_aux_wrap::CborDecoder::Decode: duplicate map key: key=";
+const std::string CborDecoderError::UnhashableMapKey =
+    "wuffs_aux_wrap::CborDecoder::Decode: unhashable map key";
+const std::string CborDecoderError::BadDepth =
+    "wuffs_aux_wrap::CborDecoder::Decode: bad depth";
+const std::string CborDecoderError::FailedToOpenFile =
+    "wuffs_aux_wrap::CborDecoder::Decode: failed to open file";
+// + 1 is for stripping leading '#'
+const std::string CborDecoderError::BadInput = wuffs_cbor__error__bad_input + 1;
+const std::string CborDecoderError::UnsupportedRecursionDepth =
+    wuffs_cbor__error__unsupported_recursion_depth + 1;
+
+// This class implements the wuffs_aux::DecodeCborCallbacks interface by
+// building Python objects from the decoded CBOR, similarly to
+// JsonObjectBuilder. Map keys may be of any hashable type.
+class CborObjectBuilder : public wuffs_aux::DecodeCborCallbacks {
+ public:
+  struct Entry {
+    Entry(pybind11::object&& jvalue_arg, std::vector<uint64_t>&& tags_arg)
+        : jvalue(std::move(jvalue_arg)),
+          has_map_key(false),
+          tags(std::move(tags_arg)) {}
+
+    pybind11::object jvalue;
+    bool has_map_key;
+    pybind11::object map_key;
+    // Tags of the container itself
+    std::vector<uint64_t> tags;
+
+    bool IsList() { return pybind11::isinstance<pybind11::list>(jvalue); }
+
+    bool IsDict() { return pybind11::isinstance<pybind11::dict>(jvalue); }
+  };
+
+  explicit CborObjectBuilder(const CborDecoderConfig& config)
+      : byte_string_views_(config.byte_string_views),
+        typed_arrays_(config.typed_arrays) {}
+
+  /* DecodeCborCallbacks methods implementation */
+
+  std::string AppendNull() override { return Append(pybind11::none()); }
+
+  std::string AppendUndefined() override {
+    return Append(pybind11::cast(CborSimpleValue{23}));
+  }
+
+  std::string AppendBool(bool val) override {
+    return Append(pybind11::bool_(val));
+  }
+
+  std::string AppendF64(double val) override {
+    return Append(pybind11::float_(val));
+  }
+
+  std::string AppendI64(int64_t val) override {
+    return Append(pybind11::int_(val));
+  }
+
+  std::string AppendU64(uint64_t val) override {
+    return Append(pybind11::int_(val));
+  }
+
+  std::string AppendByteString(std::string&& val) override {
+    if (typed_arrays_ && !pending_tags_.empty()) {
+      pybind11::dtype dtype;
+      if (GetTypedArrayDtype(pending_tags_.back(), dtype) &&
+          (val.size() % dtype.itemsize() == 0)) {
+        pending_tags_.pop_back();
+        return Append(MakeNdarray(std::move(val), dtype));
+      }
+    }
+    if (byte_string_views_ && !ExpectsMapKey()) {
+      return Append(pybind11::memoryview(
+          MakeNdarray(std::move(val), pybind11::dtype::of<uint8_t>())));
+    }
+    return Append(pybind11::bytes(val));
+  }
+
+  std::string AppendTextString(std::string&& val) override {
+    return Append(pybind11::str(val));
+  }
+
+  std::string AppendMinus1MinusX(uint64_t val) override {
+    // The value doesn't fit into int64_t
+    return Append(pybind11::reinterpret_steal<pybind11::object>(
+        PyNumber_Subtract(pybind11::int_(-1).ptr(),
+                          pybind11::int_(val).ptr())));
+  }
+
+  std::string AppendCborSimpleValue(uint8_t val) override {
+    return Append(pybind11::cast(CborSimpleValue{val}));
+  }
+
+  std::string AppendCborTag(uint64_t val) override {
+    pending_tags_.push_back(val);
+    return "";
+  }
+
+  std::string Push(uint32_t flags) override {
+    if (flags & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_LIST) {
+      stack_.emplace_back(pybind11::list(), std::move(pending_tags_));
+    } else if (flags & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_DICT) {
+      stack_.emplace_back(pybind11::dict(), std::move(pending_tags_));
+    } else {
+      return "main: internal error: bad push";
+    }
+    pending_tags_.clear();
+    return "";
+  }
+
+  std::string Pop(uint32_t) override {
+    if (stack_.empty()) {
+      return "main: internal error: bad pop";
+    }
+    Entry entry = std::move(stack_.back());
+    stack_.pop_back();
+    return AppendTagged(ApplyTags(entry.tags, std::move(entry.jvalue)));
+  }
+
+  /* End of DecodeCborCallbacks methods implementation */
+
+  // Returns the built value (or a null object if there is not exactly one
+  // top-level value) and resets the builder.
+  pybind11::object Take() {
+    pybind11::object jvalue;
+    if (stack_.size() == 1) {
+      jvalue = std::move(stack_[0].jvalue);
+    }
+    stack_.clear();
+    pending_tags_.clear();
+    return jvalue;
+  }
+
+ private:
+  std::string Append(pybind11::object&& jvalue) {
+    pybind11::object tagged = ApplyTags(pending_tags_, std::move(jvalue));
+    pending_tags_.clear();
+    return AppendTagged(std::move(tagged));
+  }
+
+  std::string AppendTagged(pybind11::object&& jvalue) {
+    if (stack_.empty()) {
+      stack_.emplace_back(std::move(jvalue), std::vector<uint64_t>());
+      return "";
+    }
+    Entry& top = stack_.back();
+    if (top.IsList()) {
+      top.jvalue.cast<pybind11::list>().append(std::move(jvalue));
+      return "";
+    } else if (top.IsDict()) {
+      const pybind11::dict& jmap = top.jvalue.cast<pybind11::dict>();
+      if (top.has_map_key) {
+        top.has_map_key = false;
+        if (jmap.contains(top.map_key)) {
+          return CborDecoderError::DuplicateMapKey +
+                 pybind11::repr(top.map_key).cast<std::string>();
+        }
+        jmap[top.map_key] = jvalue;
+        top.map_key = pybind11::object();
+        return "";
+      }
+      if (PyObject_Hash(jvalue.ptr()) == -1) {
+        PyErr_Clear();
+        return CborDecoderError::UnhashableMapKey;
+      }
+      top.has_map_key = true;
+      top.map_key = std::move(jvalue);
+      return "";
+    }
+    return "main: internal error: non-container stack entry";
+  }
+
+  bool ExpectsMapKey() {
+    return !stack_.empty() && stack_.back().IsDict() &&
+           !stack_.back().has_map_key;
+  }
+
+  // Wraps the value into CborTag objects, the innermost tag being the last
+  // one.
+  static pybind11::object ApplyTags(const std::vector<uint64_t>& tags,
+                                    pybind11::object&& jvalue) {
+    for (auto it = tags.rbegin(); it != tags.rend(); ++it) {
+      jvalue = pybind11::cast(CborTag{*it, std::move(jvalue)});
+    }
+    return std::move(jvalue);
+  }
+
+  // See RFC 8746, section 2. The 128-bit floats and the reserved tag are not
+  // supported.
+  static bool GetTypedArrayDtype(uint64_t tag, pybind11::dtype& dtype) {
+    static const char* const kFormats[] = {
+        "u1",  ">u2", ">u4", ">u8", "u1",  "<u2", "<u4", "<u8",
+        "i1",  ">i2", ">i4", ">i8", nullptr, "<i2", "<i4", "<i8",
+        ">f2", ">f4", ">f8", nullptr, "<f2", "<f4", "<f8", nullptr};
+    if ((tag < 64) || (tag > 87) || !kFormats[tag - 64]) {
+      return false;
+    }
+    dtype = pybind11::dtype(kFormats[tag - 64]);
+    return true;
+  }
+
+  // Creates a 1D NumPy array owning the buffer.
+  static pybind11::array MakeNdarray(std::string&& val,
+                                     const pybind11::dtype& dtype) {
+    auto* buffer = new std::string(std::move(val));
+    pybind11::capsule owner(
+        buffer, [](void* ptr) { delete static_cast<std::string*>(ptr); });
+    const size_t itemsize = static_cast<size_t>(dtype.itemsize());
+    return pybind11::array(dtype, {buffer->size() / itemsize}, {itemsize},
+                           buffer->data(), owner);
+  }
+
+  bool byte_string_views_;
+  bool typed_arrays_;
+  std::vector<Entry> stack_;
+  // Tags of the next value
+  std::vector<uint64_t> pending_tags_;
+};
+
+class CborDecoder {
+ public:
+  explicit CborDecoder(const CborDecoderConfig& config) : builder_(config) {}
+
+  CborDecodingResult Decode(const uint8_t* data, size_t size) {
+    wuffs_aux::sync_io::MemoryInput input(data, size);
+    return DecodeInternal(input);
+  }
+
+  CborDecodingResult Decode(const std::string& path_to_file) {
+    FILE* f = fopen(path_to_file.c_str(), "rb");
+    if (!f) {
+      CborDecodingResult result;
+      result.error_message = CborDecoderError::FailedToOpenFile;
+      result.parsed = pybind11::none();
+      return result;
+    }
+    wuffs_aux::sync_io::FileInput input(f);
+    CborDecodingResult result = DecodeInternal(input);
+    fclose(f);
+    return result;
+  }
+
+ private:
+  CborDecodingResult DecodeInternal(wuffs_aux::sync_io::Input& input) {
+    wuffs_aux::DecodeCborResult decode_cbor_result =
+        wuffs_aux::DecodeCbor(builder_, input);
+    CborDecodingResult decoding_result;
+    decoding_result.error_message = std::move(decode_cbor_result.error_message);
+    decoding_result.cursor_position = decode_cbor_result.cursor_position;
+    pybind11::object parsed = builder_.Take();
+    if (decoding_result.error_message.empty() && !parsed) {
+      decoding_result.error_message = CborDecoderError::BadDepth;
+    }
+    decoding_result.parsed = decoding_result.error_message.empty()
+                                 ? std::move(parsed)
+                                 : pybind11::none();
+    return decoding_result;
+  }
+
+  CborObjectBuilder builder_;
+};
+
+}  // namespace wuffs_aux_wrap
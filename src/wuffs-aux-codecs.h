@@ -0,0 +1,239 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// This header selects the Wuffs modules to compile and includes Wuffs, so the
+// wrappers include it instead of wuffs-unsupported-snapshot.c.
+//
+// Without PYWUFFS_CODECS, every codec is compiled in. Otherwise, the build
+// defines PYWUFFS_CODECS and a PYWUFFS_CODEC_<NAME> macro per selected codec
+// (see the PYWUFFS_CODECS option in CMakeLists.txt and setup.py), which are
+// mapped here to the WUFFS_CONFIG__MODULE__* macros of the Wuffs modules the
+// codec depends on, so that the other modules are left out of the build.
+
+#if !defined(PYWUFFS_CODECS)
+
+#define PYWUFFS_CODEC_BMP
+#define PYWUFFS_CODEC_GIF
+#define PYWUFFS_CODEC_NIE
+#define PYWUFFS_CODEC_PNG
+#define PYWUFFS_CODEC_TGA
+#define PYWUFFS_CODEC_WBMP
+#define PYWUFFS_CODEC_JPEG
+#define PYWUFFS_CODEC_WEBP
+#define PYWUFFS_CODEC_QOI
+#define PYWUFFS_CODEC_ETC2
+#define PYWUFFS_CODEC_TH
+#define PYWUFFS_CODEC_JSON
+#define PYWUFFS_CODEC_CBOR
+#define PYWUFFS_CODEC_DEFLATE
+#define PYWUFFS_CODEC_GZIP
+#define PYWUFFS_CODEC_ZLIB
+#define PYWUFFS_CODEC_BZIP2
+#define PYWUFFS_CODEC_LZMA
+#define PYWUFFS_CODEC_XZ
+#define PYWUFFS_CODEC_CRC32
+#define PYWUFFS_CODEC_ADLER32
+#define PYWUFFS_CODEC_XXHASH32
+#define PYWUFFS_CODEC_XXHASH64
+#define PYWUFFS_CODEC_SHA256
+
+#else  // !defined(PYWUFFS_CODECS)
+
+#define WUFFS_CONFIG__MODULES
+#define WUFFS_CONFIG__MODULE__BASE
+#define WUFFS_CONFIG__MODULE__AUX__BASE
+
+#if defined(PYWUFFS_CODEC_BMP)
+#define WUFFS_CONFIG__MODULE__BMP
+#endif
+#if defined(PYWUFFS_CODEC_GIF)
+#define WUFFS_CONFIG__MODULE__GIF
+#define WUFFS_CONFIG__MODULE__LZW
+#endif
+#if defined(PYWUFFS_CODEC_NIE)
+#define WUFFS_CONFIG__MODULE__NIE
+#endif
+#if defined(PYWUFFS_CODEC_PNG)
+#define WUFFS_CONFIG__MODULE__PNG
+#define WUFFS_CONFIG__MODULE__ADLER32
+#define WUFFS_CONFIG__MODULE__CRC32
+#define WUFFS_CONFIG__MODULE__DEFLATE
+#define WUFFS_CONFIG__MODULE__ZLIB
+#endif
+#if defined(PYWUFFS_CODEC_TGA)
+#define WUFFS_CONFIG__MODULE__TARGA
+#endif
+#if defined(PYWUFFS_CODEC_WBMP)
+#define WUFFS_CONFIG__MODULE__WBMP
+#endif
+#if defined(PYWUFFS_CODEC_JPEG)
+#define WUFFS_CONFIG__MODULE__JPEG
+#endif
+#if defined(PYWUFFS_CODEC_WEBP)
+#define WUFFS_CONFIG__MODULE__WEBP
+#define WUFFS_CONFIG__MODULE__VP8
+#endif
+#if defined(PYWUFFS_CODEC_QOI)
+#define WUFFS_CONFIG__MODULE__QOI
+#endif
+#if defined(PYWUFFS_CODEC_ETC2)
+#define WUFFS_CONFIG__MODULE__ETC2
+#endif
+#if defined(PYWUFFS_CODEC_TH)
+#define WUFFS_CONFIG__MODULE__THUMBHASH
+#endif
+#if defined(PYWUFFS_CODEC_JSON)
+#define WUFFS_CONFIG__MODULE__AUX__JSON
+#define WUFFS_CONFIG__MODULE__JSON
+#endif
+#if defined(PYWUFFS_CODEC_CBOR)
+#define WUFFS_CONFIG__MODULE__AUX__CBOR
+#define WUFFS_CONFIG__MODULE__CBOR
+#endif
+#if defined(PYWUFFS_CODEC_DEFLATE)
+#define WUFFS_CONFIG__MODULE__DEFLATE
+#endif
+#if defined(PYWUFFS_CODEC_GZIP)
+#define WUFFS_CONFIG__MODULE__GZIP
+#define WUFFS_CONFIG__MODULE__CRC32
+#define WUFFS_CONFIG__MODULE__DEFLATE
+#endif
+#if defined(PYWUFFS_CODEC_ZLIB)
+#define WUFFS_CONFIG__MODULE__ZLIB
+#define WUFFS_CONFIG__MODULE__ADLER32
+#define WUFFS_CONFIG__MODULE__DEFLATE
+#endif
+#if defined(PYWUFFS_CODEC_BZIP2)
+#define WUFFS_CONFIG__MODULE__BZIP2
+#endif
+#if defined(PYWUFFS_CODEC_LZMA)
+#define WUFFS_CONFIG__MODULE__LZMA
+#endif
+#if defined(PYWUFFS_CODEC_XZ)
+#define WUFFS_CONFIG__MODULE__XZ
+#define WUFFS_CONFIG__MODULE__CRC32
+#define WUFFS_CONFIG__MODULE__CRC64
+#define WUFFS_CONFIG__MODULE__LZMA
+#define WUFFS_CONFIG__MODULE__SHA256
+#endif
+#if defined(PYWUFFS_CODEC_CRC32)
+#define WUFFS_CONFIG__MODULE__CRC32
+#endif
+#if defined(PYWUFFS_CODEC_ADLER32)
+#define WUFFS_CONFIG__MODULE__ADLER32
+#endif
+#if defined(PYWUFFS_CODEC_XXHASH32)
+#define WUFFS_CONFIG__MODULE__XXHASH32
+#endif
+#if defined(PYWUFFS_CODEC_XXHASH64)
+#define WUFFS_CONFIG__MODULE__XXHASH64
+#endif
+#if defined(PYWUFFS_CODEC_SHA256)
+#define WUFFS_CONFIG__MODULE__SHA256
+#endif
+
+#endif  // !defined(PYWUFFS_CODECS)
+
+#if defined(PYWUFFS_CODEC_BMP) || defined(PYWUFFS_CODEC_GIF) ||   \
+    defined(PYWUFFS_CODEC_NIE) || defined(PYWUFFS_CODEC_PNG) ||   \
+    defined(PYWUFFS_CODEC_TGA) || defined(PYWUFFS_CODEC_WBMP) ||  \
+    defined(PYWUFFS_CODEC_JPEG) || defined(PYWUFFS_CODEC_WEBP) || \
+    defined(PYWUFFS_CODEC_QOI) || defined(PYWUFFS_CODEC_ETC2) ||  \
+    defined(PYWUFFS_CODEC_TH)
+#define PYWUFFS_CODEC_ANY_IMAGE
+#if defined(PYWUFFS_CODECS)
+#define WUFFS_CONFIG__MODULE__AUX__IMAGE
+#endif
+#endif
+
+#if defined(PYWUFFS_CODEC_DEFLATE) || defined(PYWUFFS_CODEC_GZIP) || \
+    defined(PYWUFFS_CODEC_ZLIB) || defined(PYWUFFS_CODEC_BZIP2) ||   \
+    defined(PYWUFFS_CODEC_LZMA) || defined(PYWUFFS_CODEC_XZ)
+#define PYWUFFS_CODEC_ANY_COMPRESSION
+#endif
+
+#include <wuffs-unsupported-snapshot.c>
+
+namespace wuffs_aux_wrap {
+
+// Returns the names of the compiled codecs, as given to PYWUFFS_CODECS.
+inline std::vector<std::string> CompiledCodecs() {
+  std::vector<std::string> codecs;
+#if defined(PYWUFFS_CODEC_BMP)
+  codecs.push_back("bmp");
+#endif
+#if defined(PYWUFFS_CODEC_GIF)
+  codecs.push_back("gif");
+#endif
+#if defined(PYWUFFS_CODEC_NIE)
+  codecs.push_back("nie");
+#endif
+#if defined(PYWUFFS_CODEC_PNG)
+  codecs.push_back("png");
+#endif
+#if defined(PYWUFFS_CODEC_TGA)
+  codecs.push_back("tga");
+#endif
+#if defined(PYWUFFS_CODEC_WBMP)
+  codecs.push_back("wbmp");
+#endif
+#if defined(PYWUFFS_CODEC_JPEG)
+  codecs.push_back("jpeg");
+#endif
+#if defined(PYWUFFS_CODEC_WEBP)
+  codecs.push_back("webp");
+#endif
+#if defined(PYWUFFS_CODEC_QOI)
+  codecs.push_back("qoi");
+#endif
+#if defined(PYWUFFS_CODEC_ETC2)
+  codecs.push_back("etc2");
+#endif
+#if defined(PYWUFFS_CODEC_TH)
+  codecs.push_back("th");
+#endif
+#if defined(PYWUFFS_CODEC_JSON)
+  codecs.push_back("json");
+#endif
+#if defined(PYWUFFS_CODEC_CBOR)
+  codecs.push_back("cbor");
+#endif
+#if defined(PYWUFFS_CODEC_DEFLATE)
+  codecs.push_back("deflate");
+#endif
+#if defined(PYWUFFS_CODEC_GZIP)
+  codecs.push_back("gzip");
+#endif
+#if defined(PYWUFFS_CODEC_ZLIB)
+  codecs.push_back("zlib");
+#endif
+#if defined(PYWUFFS_CODEC_BZIP2)
+  codecs.push_back("bzip2");
+#endif
+#if defined(PYWUFFS_CODEC_LZMA)
+  codecs.push_back("lzma");
+#endif
+#if defined(PYWUFFS_CODEC_XZ)
+  codecs.push_back("xz");
+#endif
+#if defined(PYWUFFS_CODEC_CRC32)
+  codecs.push_back("crc32");
+#endif
+#if defined(PYWUFFS_CODEC_ADLER32)
+  codecs.push_back("adler32");
+#endif
+#if defined(PYWUFFS_CODEC_XXHASH32)
+  codecs.push_back("xxhash32");
+#endif
+#if defined(PYWUFFS_CODEC_XXHASH64)
+  codecs.push_back("xxhash64");
+#endif
+#if defined(PYWUFFS_CODEC_SHA256)
+  codecs.push_back("sha256");
+#endif
+  return codecs;
+}
+
+}  // namespace wuffs_aux_wrap
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <pybind11/pybind11.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "wuffs-aux-codecs.h"
+#include "wuffs-aux-io-transformer.h"
+#include "wuffs-aux-utils.h"
+
+// This API exposes the Wuffs decoders for compression formats. Unlike for
+// images and JSON, there is no wuffs_aux API for them, so the wrapper drives
+// the wuffs_base__io_transformer interface directly.
+
+namespace wuffs_aux_wrap {
+
+enum class DecompressorQuirks : uint32_t {
+  IGNORE_CHECKSUM = WUFFS_BASE__QUIRK_IGNORE_CHECKSUM
+};
+
+struct DecompressorConfig {
+  DecompressorType type = DecompressorType::GZIP;
+  std::map<DecompressorQuirks, uint64_t> quirks;
+  // Maximum decompressed size of a stream, 0 means no limit
+  uint64_t max_output_size = 0;
+};
+
+struct DecompressionResult {
+  std::vector<uint8_t> data;
+  std::string error_message;
+
+  DecompressionResult() = default;
+
+  DecompressionResult(DecompressionResult&& other) noexcept {
+    std::swap(data, other.data);
+    std::swap(error_message, other.error_message);
+  }
+
+  DecompressionResult& operator=(DecompressionResult&& other) noexcept {
+    if (this != &other) {
+      std::swap(data, other.data);
+      std::swap(error_message, other.error_message);
+    }
+    return *this;
+  }
+
+  DecompressionResult(DecompressionResult& other) = delete;
+  DecompressionResult& operator=(DecompressionResult& other) = delete;
+};
+
+// This class is not thread-safe: Feed (which releases the GIL) and Reset
+// mutate the state of the fed stream.
+class Decompressor {
+ public:
+  explicit Decompressor(const DecompressorConfig& config)
+      : config_(config), quirks_vector_(utils::ConvertQuirks(config.quirks)) {
+    Reset();
+  }
+
+  // Decompresses a whole stream.
+  DecompressionResult Decompress(const uint8_t* data, size_t size) {
+    pybind11::gil_scoped_release release_gil;
+    DecompressionResult result;
+    wuffs_base__io_transformer::unique_ptr transformer =
+        CreateTransformer(result.error_message);
+    if (!transformer) {
+      return result;
+    }
+    // The compression ratio is unknown, so start with a guess
+    result.data.resize(std::min<uint64_t>(
+        std::max<size_t>(4 * size, kMinBufferSize), MaxDstLength(0, 0)));
+    wuffs_base__io_buffer src =
+        wuffs_base__ptr_u8__reader(const_cast<uint8_t*>(data), size, true);
+    std::vector<uint8_t> workbuf;
+    size_t dst_length = 0;
+    bool finished = false;
+    result.error_message =
+        Transform(transformer.get(), &src, result.data, dst_length,
+                  MaxDstLength(0, 0), workbuf, finished);
+    result.data.resize(dst_length);
+    return result;
+  }
+
+  // Starts a new stream for Feed.
+  void Reset() {
+    error_message_.clear();
+    transformer_ = CreateTransformer(error_message_);
+    pending_src_.clear();
+    dst_.clear();
+    dst_length_ = 0;
+    workbuf_.clear();
+    total_output_size_ = 0;
+    finished_ = false;
+  }
+
+  // Decompresses the next chunk of the stream. The returned output points to
+  // the internal buffer which is reused by the next call. Errors are sticky,
+  // the data after the end of the stream is ignored.
+  std::pair<const uint8_t*, size_t> Feed(const uint8_t* data, size_t size) {
+    if (!error_message_.empty() || finished_) {
+      return {nullptr, 0};
+    }
+    pybind11::gil_scoped_release release_gil;
+
+    // Drop the previous output except for the history the transformer needs
+    const size_t retained = static_cast<size_t>(std::min<uint64_t>(
+        DstHistoryRetainLength(transformer_.get()), dst_length_));
+    if (retained > 0) {
+      std::memmove(dst_.data(), dst_.data() + dst_length_ - retained,
+                   retained);
+    }
+    dst_length_ = retained;
+
+    // The unconsumed input is only copied if there is any
+    if (!pending_src_.empty()) {
+      pending_src_.insert(pending_src_.end(), data, data + size);
+      data = pending_src_.data();
+      size = pending_src_.size();
+    }
+    wuffs_base__io_buffer src =
+        wuffs_base__ptr_u8__reader(const_cast<uint8_t*>(data), size, false);
+    error_message_ =
+        Transform(transformer_.get(), &src, dst_, dst_length_,
+                  MaxDstLength(retained, total_output_size_), workbuf_,
+                  finished_);
+    std::vector<uint8_t> unconsumed_src(data + src.meta.ri, data + size);
+    pending_src_.swap(unconsumed_src);
+
+    total_output_size_ += dst_length_ - retained;
+    return {dst_.data() + retained, dst_length_ - retained};
+  }
+
+  const std::string& error_message() const { return error_message_; }
+
+  bool finished() const { return finished_; }
+
+ private:
+  static constexpr size_t kMinBufferSize = 64 * 1024;
+
+  wuffs_base__io_transformer::unique_ptr CreateTransformer(
+      std::string& error_message) {
+    return CreateIoTransformer(config_.type, quirks_vector_, error_message);
+  }
+
+  // Returns the maximum length of the output buffer holding the given number
+  // of retained bytes, given the stream output size so far.
+  uint64_t MaxDstLength(size_t retained, uint64_t total_output_size) const {
+    if (config_.max_output_size == 0) {
+      return SIZE_MAX;
+    }
+    return retained + config_.max_output_size -
+           std::min(total_output_size, config_.max_output_size);
+  }
+
+  static uint64_t DstHistoryRetainLength(
+      wuffs_base__io_transformer* transformer) {
+    if (!transformer) {
+      return 0;
+    }
+    const wuffs_base__optional_u63 length =
+        transformer->dst_history_retain_length();
+    // No value means that the whole history has to be retained
+    return length.has_value() ? length.value() : UINT64_MAX;
+  }
+
+  // Runs the transformer until it needs more input or the stream ends,
+  // appending the output to dst, which grows up to max_dst_length.
+  static std::string Transform(wuffs_base__io_transformer* transformer,
+                               wuffs_base__io_buffer* src,
+                               std::vector<uint8_t>& dst, size_t& dst_length,
+                               uint64_t max_dst_length,
+                               std::vector<uint8_t>& workbuf, bool& finished) {
+    if (!transformer) {
+      return DecompressorError::OutOfMemory;
+    }
+    bool short_write = false;
+    while (true) {
+      // The work buffer length may depend on the stream header
+      const uint64_t workbuf_length = transformer->workbuf_len().max_incl;
+      if (workbuf_length > SIZE_MAX) {
+        return DecompressorError::OutOfMemory;
+      } else if (workbuf.size() < workbuf_length) {
+        workbuf.resize(static_cast<size_t>(workbuf_length));
+      }
+      // The buffer may be larger than allowed if it's reused
+      size_t capacity =
+          static_cast<size_t>(std::min<uint64_t>(dst.size(), max_dst_length));
+      if ((dst_length == capacity) || short_write) {
+        const uint64_t new_size = std::min<uint64_t>(
+            std::max<size_t>(2 * capacity, kMinBufferSize), max_dst_length);
+        if (new_size <= capacity) {
+          return DecompressorError::MaxOutputSizeExceeded;
+        }
+        capacity = static_cast<size_t>(new_size);
+        if (dst.size() < capacity) {
+          dst.resize(capacity);
+        }
+      }
+      wuffs_base__io_buffer dst_buf =
+          wuffs_base__ptr_u8__writer(dst.data(), capacity);
+      dst_buf.meta.wi = dst_length;
+      const wuffs_base__status status = transformer->transform_io(
+          &dst_buf, src,
+          wuffs_base__make_slice_u8(workbuf.data(), workbuf.size()));
+      dst_length = dst_buf.meta.wi;
+      short_write = (status.repr == wuffs_base__suspension__short_write);
+      if (status.repr == nullptr) {
+        finished = true;
+        return "";
+      } else if (short_write) {
+        continue;
+      } else if (status.repr == wuffs_base__suspension__short_read) {
+        return src->meta.closed ? DecompressorError::UnexpectedEndOfFile : "";
+      }
+      return status.message();
+    }
+  }
+
+  DecompressorConfig config_;
+  std::vector<wuffs_aux::QuirkKeyValuePair> quirks_vector_;
+  // Feed state
+  wuffs_base__io_transformer::unique_ptr transformer_{nullptr};
+  std::vector<uint8_t> pending_src_;
+  std::vector<uint8_t> dst_;
+  size_t dst_length_ = 0;
+  std::vector<uint8_t> workbuf_;
+  uint64_t total_output_size_ = 0;
+  bool finished_ = false;
+  std::string error_message_;
+};
+
+}  // namespace wuffs_aux_wrap
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <pybind11/pybind11.h>
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "wuffs-aux-codecs.h"
+#include "wuffs-aux-utils.h"
+
+// This API exposes the Wuffs checksum and hash implementations. The hashing
+// runs with the GIL released, except for small buffers.
+
+namespace wuffs_aux_wrap {
+
+using Buffer = std::pair<const uint8_t*, size_t>;
+
+// Incremental hasher. HasherTraits defines the Wuffs hasher type, the digest
+// type and how to update and read it. The public methods must be called with
+// the GIL held, and an instance may be shared between Python threads: the
+// hasher is guarded by a mutex (as in hashlib), since Update releases the GIL.
+template <typename HasherTraits>
+class Hasher {
+ public:
+  using Digest = typename HasherTraits::Digest;
+
+  // Buffers smaller than this are hashed with the GIL held, since releasing
+  // and reacquiring it costs more than hashing a few bytes (hashlib uses the
+  // same threshold).
+  static constexpr size_t kReleaseGilMinSize = 2048;
+
+  Hasher() : hasher_(Alloc()) {}
+
+  void Reset() {
+    typename HasherTraits::Type::unique_ptr hasher = Alloc();
+    std::unique_lock<std::mutex> lock = Lock();
+    hasher_.swap(hasher);
+  }
+
+  void Update(const uint8_t* data, size_t size) {
+    if (size < kReleaseGilMinSize) {
+      std::unique_lock<std::mutex> lock = Lock();
+      UpdateInternal(data, size);
+      return;
+    }
+    pybind11::gil_scoped_release release_gil;
+    std::lock_guard<std::mutex> lock(mutex_);
+    UpdateInternal(data, size);
+  }
+
+  Digest Checksum() const {
+    std::unique_lock<std::mutex> lock = Lock();
+    return ChecksumInternal();
+  }
+
+  // Hashes a whole buffer.
+  static Digest Hash(const uint8_t* data, size_t size) {
+    if (size < kReleaseGilMinSize) {
+      return HashInternal(data, size);
+    }
+    pybind11::gil_scoped_release release_gil;
+    return HashInternal(data, size);
+  }
+
+  // Hashes every buffer on up to num_threads native threads (0 stands for the
+  // number of hardware threads).
+  static std::vector<Digest> HashMany(const std::vector<Buffer>& buffers,
+                                      size_t num_threads) {
+    pybind11::gil_scoped_release release_gil;
+    std::vector<Digest> digests(buffers.size());
+    utils::ParallelFor(buffers.size(), num_threads, [&](size_t i) {
+      digests[i] = HashInternal(buffers[i].first, buffers[i].second);
+    });
+    return digests;
+  }
+
+ private:
+  static typename HasherTraits::Type::unique_ptr Alloc() {
+    typename HasherTraits::Type::unique_ptr hasher =
+        HasherTraits::Type::alloc();
+    if (!hasher) {
+      throw std::bad_alloc();
+    }
+    return hasher;
+  }
+
+  // Doesn't need the GIL, as the hasher is local.
+  static Digest HashInternal(const uint8_t* data, size_t size) {
+    Hasher hasher;
+    hasher.UpdateInternal(data, size);
+    return hasher.ChecksumInternal();
+  }
+
+  // Locks the mutex, releasing the GIL while waiting if another thread holds
+  // it (e.g. while updating with the GIL released).
+  std::unique_lock<std::mutex> Lock() const {
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      pybind11::gil_scoped_release release_gil;
+      lock.lock();
+    }
+    return lock;
+  }
+
+  void UpdateInternal(const uint8_t* data, size_t size) {
+    HasherTraits::Update(
+        hasher_.get(),
+        wuffs_base__make_slice_u8(const_cast<uint8_t*>(data), size));
+  }
+
+  Digest ChecksumInternal() const {
+    return HasherTraits::Checksum(hasher_.get());
+  }
+
+  typename HasherTraits::Type::unique_ptr hasher_;
+  mutable std::mutex mutex_;
+};
+
+template <typename T>
+struct HasherU32Traits {
+  using Type = T;
+  using Digest = uint32_t;
+
+  static void Update(T* hasher, wuffs_base__slice_u8 data) {
+    hasher->update_u32(data);
+  }
+
+  static Digest Checksum(T* hasher) { return hasher->checksum_u32(); }
+};
+
+template <typename T>
+struct HasherU64Traits {
+  using Type = T;
+  using Digest = uint64_t;
+
+  static void Update(T* hasher, wuffs_base__slice_u8 data) {
+    hasher->update_u64(data);
+  }
+
+  static Digest Checksum(T* hasher) { return hasher->checksum_u64(); }
+};
+
+#if defined(PYWUFFS_CODEC_SHA256)
+struct Sha256Traits {
+  using Type = wuffs_sha256__hasher;
+  using Digest = std::array<uint8_t, 32>;
+
+  static void Update(Type* hasher, wuffs_base__slice_u8 data) {
+    hasher->update_bitvec256(data);
+  }
+
+  // The first element holds the least significant 64 bits of the big endian
+  // digest.
+  static Digest Checksum(Type* hasher) {
+    const wuffs_base__bitvec256 bitvec = hasher->checksum_bitvec256();
+    Digest digest;
+    for (size_t i = 0; i < 4; i++) {
+      wuffs_base__poke_u64be__no_bounds_check(
+          digest.data() + 8 * i, bitvec.elements_u64[3 - i]);
+    }
+    return digest;
+  }
+};
+
+#endif
+
+#if defined(PYWUFFS_CODEC_CRC32)
+using Crc32Hasher = Hasher<HasherU32Traits<wuffs_crc32__ieee_hasher>>;
+#endif
+#if defined(PYWUFFS_CODEC_ADLER32)
+using Adler32Hasher = Hasher<HasherU32Traits<wuffs_adler32__hasher>>;
+#endif
+#if defined(PYWUFFS_CODEC_XXHASH32)
+using XxHash32Hasher = Hasher<HasherU32Traits<wuffs_xxhash32__hasher>>;
+#endif
+#if defined(PYWUFFS_CODEC_XXHASH64)
+using XxHash64Hasher = Hasher<HasherU64Traits<wuffs_xxhash64__hasher>>;
+#endif
+#if defined(PYWUFFS_CODEC_SHA256)
+using Sha256Hasher = Hasher<Sha256Traits>;
+#endif
+
+}  // namespace wuffs_aux_wrap
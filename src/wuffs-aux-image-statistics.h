@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "wuffs-aux-codecs.h"
+
+// This API implements the image statistics and perceptual hashes which the
+// image decoder computes over the decoded pixels (see
+// ImageDecoderConfig::compute), all of them in a single pass.
+
+namespace wuffs_aux_wrap {
+
+enum class ImageStatistic : uint32_t {
+  // 256-bin histogram of the BT.601 luma
+  LUMA_HISTOGRAM,
+  // Per-channel mean and standard deviation
+  MEAN_STD,
+  // Per-channel minimum and maximum
+  MIN_MAX,
+  // 64-bit difference hash of the luma
+  DHASH,
+  // 64-bit DCT-based perceptual hash of the luma
+  PHASH
+};
+
+inline uint32_t ImageStatisticBit(ImageStatistic statistic) {
+  return 1u << static_cast<uint32_t>(statistic);
+}
+
+struct ImageStatistics {
+  // Bitmask of the computed statistics (see ImageStatisticBit)
+  uint32_t computed = 0;
+  std::array<uint64_t, 256> luma_histogram{};
+  // Per channel, in the order of the pixel format
+  std::vector<double> mean;
+  std::vector<double> stddev;
+  std::vector<uint8_t> minimum;
+  std::vector<uint8_t> maximum;
+  uint64_t dhash = 0;
+  uint64_t phash = 0;
+
+  bool has(ImageStatistic statistic) const {
+    return (computed & ImageStatisticBit(statistic)) != 0;
+  }
+};
+
+// This class downsamples the luma of an image to a grid of kWidth x kHeight
+// cells row by row, averaging the pixels of each cell. Along an axis shorter
+// than the grid, the pixels are repeated instead (i.e. cell c takes pixel
+// c * n / kWidth for an image of width n).
+template <size_t kWidth, size_t kHeight>
+class LumaGrid {
+ public:
+  LumaGrid(size_t width, size_t height) {
+    GetCellRanges(width, kWidth, column_cells_, column_counts_);
+    GetCellRanges(height, kHeight, row_cells_, row_counts_);
+  }
+
+  void AddRow(size_t y, const uint8_t* luma, size_t width) {
+    std::array<uint64_t, kWidth> row_sums{};
+    for (size_t x = 0; x < width; x++) {
+      for (uint32_t c = column_cells_[x].first; c < column_cells_[x].second;
+           c++) {
+        row_sums[c] += luma[x];
+      }
+    }
+    for (uint32_t r = row_cells_[y].first; r < row_cells_[y].second; r++) {
+      for (size_t c = 0; c < kWidth; c++) {
+        sums_[r][c] += row_sums[c];
+      }
+    }
+  }
+
+  double Cell(size_t r, size_t c) const {
+    return static_cast<double>(sums_[r][c]) /
+           (static_cast<double>(row_counts_[r]) * column_counts_[c]);
+  }
+
+ private:
+  // Finds the [first, second) range of cells of every pixel along an axis of
+  // n pixels and the number of pixels of every cell.
+  template <size_t kCells>
+  static void GetCellRanges(size_t n, size_t cells,
+                            std::vector<std::pair<uint32_t, uint32_t>>& ranges,
+                            std::array<uint64_t, kCells>& counts) {
+    ranges.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      if (n >= cells) {
+        const uint32_t cell = static_cast<uint32_t>(i * cells / n);
+        ranges[i] = {cell, cell + 1};
+      } else {
+        ranges[i] = {static_cast<uint32_t>((i * cells + n - 1) / n),
+                     static_cast<uint32_t>(((i + 1) * cells + n - 1) / n)};
+      }
+      for (uint32_t c = ranges[i].first; c < ranges[i].second; c++) {
+        counts[c]++;
+      }
+    }
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> column_cells_;
+  std::vector<std::pair<uint32_t, uint32_t>> row_cells_;
+  std::array<uint64_t, kWidth> column_counts_{};
+  std::array<uint64_t, kHeight> row_counts_{};
+  std::array<std::array<uint64_t, kWidth>, kHeight> sums_{};
+};
+
+// This class computes the requested ImageStatistics of 8-bit interleaved
+// pixels in one pass, row by row: the per-channel sums and extrema, then the
+// luma of the row, which feeds the histogram and the hash grids.
+class ImageStatisticsComputer {
+ public:
+  // Returns false if the pixel format is not supported, i.e. if it's not one
+  // of Y, YA, BGR, RGB, BGRA, RGBA, BGRX and RGBX.
+  static bool Compute(const uint8_t* pixels, size_t width, size_t height,
+                      size_t stride, uint32_t pixel_format, uint32_t requested,
+                      ImageStatistics& statistics) {
+    Layout layout;
+    if (!GetLayout(pixel_format, layout)) {
+      return false;
+    }
+    statistics = ImageStatistics();
+    statistics.computed = requested;
+    if ((width == 0) || (height == 0)) {
+      // All zeros, as there are no pixels to average
+      if (requested & ImageStatisticBit(ImageStatistic::MEAN_STD)) {
+        statistics.mean.resize(layout.channels);
+        statistics.stddev.resize(layout.channels);
+      }
+      if (requested & ImageStatisticBit(ImageStatistic::MIN_MAX)) {
+        statistics.minimum.resize(layout.channels);
+        statistics.maximum.resize(layout.channels);
+      }
+      return true;
+    }
+    switch (layout.channels) {
+      case 1:
+        Pass<1>(pixels, width, height, stride, layout, requested, statistics);
+        break;
+      case 2:
+        Pass<2>(pixels, width, height, stride, layout, requested, statistics);
+        break;
+      case 3:
+        Pass<3>(pixels, width, height, stride, layout, requested, statistics);
+        break;
+      default:
+        Pass<4>(pixels, width, height, stride, layout, requested, statistics);
+    }
+    return true;
+  }
+
+ private:
+  // The number of channels and the indices of the red, green and blue
+  // channels (all 0 for the gray formats)
+  struct Layout {
+    size_t channels;
+    size_t r;
+    size_t g;
+    size_t b;
+  };
+
+  static bool GetLayout(uint32_t pixel_format, Layout& layout) {
+    switch (pixel_format) {
+      case WUFFS_BASE__PIXEL_FORMAT__Y:
+        layout = {1, 0, 0, 0};
+        return true;
+      case WUFFS_BASE__PIXEL_FORMAT__YA_NONPREMUL:
+      case WUFFS_BASE__PIXEL_FORMAT__YA_PREMUL:
+        layout = {2, 0, 0, 0};
+        return true;
+      case WUFFS_BASE__PIXEL_FORMAT__BGR:
+        layout = {3, 2, 1, 0};
+        return true;
+      case WUFFS_BASE__PIXEL_FORMAT__RGB:
+        layout = {3, 0, 1, 2};
+        return true;
+      case WUFFS_BASE__PIXEL_FORMAT__BGRA_NONPREMUL:
+      case WUFFS_BASE__PIXEL_FORMAT__BGRA_PREMUL:
+      case WUFFS_BASE__PIXEL_FORMAT__BGRA_BINARY:
+      case WUFFS_BASE__PIXEL_FORMAT__BGRX:
+        layout = {4, 2, 1, 0};
+        return true;
+      case WUFFS_BASE__PIXEL_FORMAT__RGBA_NONPREMUL:
+      case WUFFS_BASE__PIXEL_FORMAT__RGBA_PREMUL:
+      case WUFFS_BASE__PIXEL_FORMAT__RGBA_BINARY:
+      case WUFFS_BASE__PIXEL_FORMAT__RGBX:
+        layout = {4, 0, 1, 2};
+        return true;
+    }
+    return false;
+  }
+
+  template <size_t kChannels>
+  static void Pass(const uint8_t* pixels, size_t width, size_t height,
+                   size_t stride, const Layout& layout, uint32_t requested,
+                   ImageStatistics& statistics) {
+    const bool channel_stats =
+        (requested & (ImageStatisticBit(ImageStatistic::MEAN_STD) |
+                      ImageStatisticBit(ImageStatistic::MIN_MAX))) != 0;
+    const bool histogram =
+        (requested & ImageStatisticBit(ImageStatistic::LUMA_HISTOGRAM)) != 0;
+    std::unique_ptr<LumaGrid<9, 8>> dhash_grid;
+    if (requested & ImageStatisticBit(ImageStatistic::DHASH)) {
+      dhash_grid.reset(new LumaGrid<9, 8>(width, height));
+    }
+    std::unique_ptr<LumaGrid<32, 32>> phash_grid;
+    if (requested & ImageStatisticBit(ImageStatistic::PHASH)) {
+      phash_grid.reset(new LumaGrid<32, 32>(width, height));
+    }
+    const bool luma_stats = histogram || dhash_grid || phash_grid;
+
+    std::array<uint64_t, kChannels> sums{};
+    std::array<uint64_t, kChannels> squares{};
+    std::array<uint8_t, kChannels> minimum;
+    std::array<uint8_t, kChannels> maximum;
+    minimum.fill(0xFF);
+    maximum.fill(0);
+    std::vector<uint8_t> luma(luma_stats ? width : 0);
+    for (size_t y = 0; y < height; y++) {
+      const uint8_t* row = pixels + y * stride;
+      if (channel_stats) {
+        for (size_t x = 0; x < width; x++) {
+          for (size_t c = 0; c < kChannels; c++) {
+            const uint8_t v = row[x * kChannels + c];
+            sums[c] += v;
+            squares[c] += static_cast<uint32_t>(v) * v;
+            minimum[c] = std::min(minimum[c], v);
+            maximum[c] = std::max(maximum[c], v);
+          }
+        }
+      }
+      if (!luma_stats) {
+        continue;
+      }
+      for (size_t x = 0; x < width; x++) {
+        const uint8_t* p = row + x * kChannels;
+        if (kChannels < 3) {
+          luma[x] = p[0];
+        } else {
+          // Integer BT.601 weights, summing up to 256
+          luma[x] = static_cast<uint8_t>((77 * p[layout.r] + 150 * p[layout.g] +
+                                          29 * p[layout.b] + 128) >>
+                                         8);
+        }
+      }
+      if (histogram) {
+        for (size_t x = 0; x < width; x++) {
+          statistics.luma_histogram[luma[x]]++;
+        }
+      }
+      if (dhash_grid) {
+        dhash_grid->AddRow(y, luma.data(), width);
+      }
+      if (phash_grid) {
+        phash_grid->AddRow(y, luma.data(), width);
+      }
+    }
+
+    const double num_pixels = static_cast<double>(width) * height;
+    for (size_t c = 0; c < kChannels; c++) {
+      if (requested & ImageStatisticBit(ImageStatistic::MEAN_STD)) {
+        const double mean = sums[c] / num_pixels;
+        statistics.mean.push_back(mean);
+        statistics.stddev.push_back(
+            std::sqrt(std::max(0.0, squares[c] / num_pixels - mean * mean)));
+      }
+      if (requested & ImageStatisticBit(ImageStatistic::MIN_MAX)) {
+        statistics.minimum.push_back(minimum[c]);
+        statistics.maximum.push_back(maximum[c]);
+      }
+    }
+    if (dhash_grid) {
+      statistics.dhash = DHash(*dhash_grid);
+    }
+    if (phash_grid) {
+      statistics.phash = PHash(*phash_grid);
+    }
+  }
+
+  // One bit per pair of horizontally adjacent cells, set if the right one is
+  // brighter, in row-major order starting from the most significant bit
+  static uint64_t DHash(const LumaGrid<9, 8>& grid) {
+    uint64_t hash = 0;
+    for (size_t r = 0; r < 8; r++) {
+      for (size_t c = 0; c < 8; c++) {
+        hash = (hash << 1) | (grid.Cell(r, c + 1) > grid.Cell(r, c) ? 1 : 0);
+      }
+    }
+    return hash;
+  }
+
+  // One bit per 8x8 lowest frequency DCT-II coefficient of the 32x32 grid,
+  // set if it's above their median, in row-major order starting from the most
+  // significant bit. The hash of an image smaller than the grid is not
+  // meaningful, as most of the coefficients are null then.
+  static uint64_t PHash(const LumaGrid<32, 32>& grid) {
+    constexpr size_t kSize = 32;
+    constexpr size_t kLowSize = 8;
+    const double kPi = 3.14159265358979323846;
+    std::array<std::array<double, kSize>, kLowSize> cosines;
+    for (size_t u = 0; u < kLowSize; u++) {
+      for (size_t x = 0; x < kSize; x++) {
+        cosines[u][x] = std::cos(kPi * (2 * x + 1) * u / (2 * kSize));
+      }
+    }
+    // Along the columns first, then along the rows
+    std::array<std::array<double, kSize>, kLowSize> columns{};
+    for (size_t u = 0; u < kLowSize; u++) {
+      for (size_t y = 0; y < kSize; y++) {
+        for (size_t x = 0; x < kSize; x++) {
+          columns[u][x] += cosines[u][y] * grid.Cell(y, x);
+        }
+      }
+    }
+    std::array<double, kLowSize * kLowSize> coefficients{};
+    for (size_t u = 0; u < kLowSize; u++) {
+      for (size_t v = 0; v < kLowSize; v++) {
+        for (size_t x = 0; x < kSize; x++) {
+          coefficients[u * kLowSize + v] += cosines[v][x] * columns[u][x];
+        }
+      }
+    }
+    std::array<double, kLowSize * kLowSize> sorted = coefficients;
+    std::sort(sorted.begin(), sorted.end());
+    const double median =
+        (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
+    uint64_t hash = 0;
+    for (const double coefficient : coefficients) {
+      hash = (hash << 1) | (coefficient > median ? 1 : 0);
+    }
+    return hash;
+  }
+};
+
+}  // namespace wuffs_aux_wrap
@@ -1,12 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
 #include <map>
 #include <string>
 #include <unordered_set>
 #include <utility>
 #include <vector>
-#include <wuffs-unsupported-snapshot.c>
 
+#include "wuffs-aux-codecs.h"
+#include "wuffs-aux-image-statistics.h"
+#include "wuffs-aux-io-transformer.h"
+#include "wuffs-aux-metrics.h"
 #include "wuffs-aux-utils.h"
 
 // This API wraps the wuffs_aux API for image decoding. The wrapper is needed
@@ -37,6 +44,7 @@ enum class ImageDecoderFlags : uint64_t {
 
 enum class ImageDecoderQuirks : uint32_t {
   IGNORE_CHECKSUM = WUFFS_BASE__QUIRK_IGNORE_CHECKSUM,
+#if defined(PYWUFFS_CODEC_GIF)
   GIF_DELAY_NUM_DECODED_FRAMES = WUFFS_GIF__QUIRK_DELAY_NUM_DECODED_FRAMES,
   GIF_FIRST_FRAME_LOCAL_PALETTE_MEANS_BLACK_BACKGROUND =
       WUFFS_GIF__QUIRK_FIRST_FRAME_LOCAL_PALETTE_MEANS_BLACK_BACKGROUND,
@@ -45,6 +53,7 @@ enum class ImageDecoderQuirks : uint32_t {
   GIF_IMAGE_BOUNDS_ARE_STRICT = WUFFS_GIF__QUIRK_IMAGE_BOUNDS_ARE_STRICT,
   GIF_REJECT_EMPTY_FRAME = WUFFS_GIF__QUIRK_REJECT_EMPTY_FRAME,
   GIF_REJECT_EMPTY_PALETTE = WUFFS_GIF__QUIRK_REJECT_EMPTY_PALETTE,
+#endif
   QUALITY = WUFFS_BASE__QUIRK_QUALITY
 };
 
@@ -68,6 +77,68 @@ enum class ImageDecoderType : uint32_t {
 #undef IDTE
 };
 
+// Returns the ImageDecoderType name of the given FourCC, "UNKNOWN" if it's not
+// one of the supported types.
+inline const char* ImageDecoderTypeName(uint32_t fourcc) {
+  switch (static_cast<ImageDecoderType>(fourcc)) {
+#define IDTN(dt)             \
+  case ImageDecoderType::dt: \
+    return #dt
+    IDTN(BMP);
+    IDTN(GIF);
+    IDTN(NIE);
+    IDTN(PNG);
+    IDTN(TGA);
+    IDTN(WBMP);
+    IDTN(JPEG);
+    IDTN(WEBP);
+    IDTN(QOI);
+    IDTN(ETC2);
+    IDTN(TH);
+#undef IDTN
+  }
+  return "UNKNOWN";
+}
+
+// Returns the decoder types compiled in (see wuffs-aux-codecs.h).
+inline std::vector<ImageDecoderType> CompiledImageDecoderTypes() {
+  std::vector<ImageDecoderType> types;
+#if defined(PYWUFFS_CODEC_BMP)
+  types.push_back(ImageDecoderType::BMP);
+#endif
+#if defined(PYWUFFS_CODEC_GIF)
+  types.push_back(ImageDecoderType::GIF);
+#endif
+#if defined(PYWUFFS_CODEC_NIE)
+  types.push_back(ImageDecoderType::NIE);
+#endif
+#if defined(PYWUFFS_CODEC_PNG)
+  types.push_back(ImageDecoderType::PNG);
+#endif
+#if defined(PYWUFFS_CODEC_TGA)
+  types.push_back(ImageDecoderType::TGA);
+#endif
+#if defined(PYWUFFS_CODEC_WBMP)
+  types.push_back(ImageDecoderType::WBMP);
+#endif
+#if defined(PYWUFFS_CODEC_JPEG)
+  types.push_back(ImageDecoderType::JPEG);
+#endif
+#if defined(PYWUFFS_CODEC_WEBP)
+  types.push_back(ImageDecoderType::WEBP);
+#endif
+#if defined(PYWUFFS_CODEC_QOI)
+  types.push_back(ImageDecoderType::QOI);
+#endif
+#if defined(PYWUFFS_CODEC_ETC2)
+  types.push_back(ImageDecoderType::ETC2);
+#endif
+#if defined(PYWUFFS_CODEC_TH)
+  types.push_back(ImageDecoderType::TH);
+#endif
+  return types;
+}
+
 enum class PixelFormat : uint32_t {
 #define PFE(pf) pf = WUFFS_BASE__PIXEL_FORMAT__##pf
   PFE(A),
@@ -135,14 +206,27 @@ struct ImageDecoderConfig {
       wuffs_aux::DecodeImageArgMaxInclDimension::DefaultValue().repr;
   uint64_t max_incl_metadata_length =
       wuffs_aux::DecodeImageArgMaxInclMetadataLength::DefaultValue().repr;
-  std::vector<ImageDecoderType> enabled_decoders = {
-      ImageDecoderType::BMP,  ImageDecoderType::GIF,  ImageDecoderType::NIE,
-      ImageDecoderType::PNG,  ImageDecoderType::TGA,  ImageDecoderType::WBMP,
-      ImageDecoderType::JPEG, ImageDecoderType::WEBP, ImageDecoderType::QOI,
-      ImageDecoderType::ETC2, ImageDecoderType::TH};
+  std::vector<ImageDecoderType> enabled_decoders = CompiledImageDecoderTypes();
   uint32_t pixel_format = wuffs_base__make_pixel_format(
                               static_cast<uint32_t>(PixelFormat::BGRA_PREMUL))
                               .repr;
+  // Compression of the input, which is decompressed on the fly
+  InputCompression compression = InputCompression::NONE;
+  // If true, the decoding results hold the timing breakdown of the decode
+  bool collect_stats = false;
+  // Region of interest as (x, y, width, height), intersected with the image
+  // bounds (after applying the EXIF orientation). A zero width or height means
+  // no cropping.
+  std::array<uint32_t, 4> crop = {0, 0, 0, 0};
+  // If true, the pixels are rotated and/or flipped as told by the EXIF
+  // orientation tag, if any
+  bool apply_exif_orientation = false;
+  // Statistics computed over the output pixels (i.e. after the EXIF
+  // orientation and the crop) right after decoding them
+  std::vector<ImageStatistic> compute;
+  // If false, the decoding results hold no pixels (but still hold the pixel
+  // configuration), e.g. when only the statistics are needed
+  bool return_pixbuf = true;
 };
 
 // This struct represents the wuffs_aux::DecodeImageCallbacks::HandleMetadata
@@ -179,6 +263,10 @@ struct ImageDecodingResult {
   std::vector<uint8_t> pixbuf;
   std::vector<MetadataEntry> reported_metadata;
   std::string error_message;
+  // Only filled if ImageDecoderConfig::collect_stats is set
+  DecodingStats stats;
+  // Only filled if ImageDecoderConfig::compute is not empty
+  ImageStatistics statistics;
 
   ImageDecodingResult() = default;
 
@@ -187,6 +275,8 @@ struct ImageDecodingResult {
     std::swap(pixbuf, other.pixbuf);
     std::swap(reported_metadata, other.reported_metadata);
     std::swap(error_message, other.error_message);
+    std::swap(stats, other.stats);
+    std::swap(statistics, other.statistics);
   }
 
   ImageDecodingResult& operator=(ImageDecodingResult&& other) noexcept {
@@ -195,6 +285,8 @@ struct ImageDecodingResult {
       std::swap(pixbuf, other.pixbuf);
       std::swap(reported_metadata, other.reported_metadata);
       std::swap(error_message, other.error_message);
+      std::swap(stats, other.stats);
+      std::swap(statistics, other.statistics);
     }
     return *this;
   }
@@ -214,6 +306,9 @@ struct ImageDecoderError {
   static const std::string UnsupportedPixelConfiguration;
   static const std::string UnsupportedPixelFormat;
   static const std::string FailedToOpenFile;
+  static const std::string FailedToReadFile;
+  static const std::string CropOutOfBounds;
+  static const std::string UnsupportedStatisticsPixelFormat;
 };
 
 const std::string ImageDecoderError::MaxInclDimensionExceeded =
@@ -236,6 +331,98 @@ const std::string ImageDecoderError::UnsupportedPixelFormat =
     wuffs_aux::DecodeImage_UnsupportedPixelFormat;
 const std::string ImageDecoderError::FailedToOpenFile =
     "wuffs_aux_wrap::ImageDecoder::Decode: failed to open file";
+const std::string ImageDecoderError::FailedToReadFile =
+    "wuffs_aux_wrap::ImageDecoder::Decode: failed to read file";
+const std::string ImageDecoderError::CropOutOfBounds =
+    "wuffs_aux_wrap::ImageDecoder::Decode: crop region is out of the image "
+    "bounds";
+const std::string ImageDecoderError::UnsupportedStatisticsPixelFormat =
+    "wuffs_aux_wrap::ImageDecoder::Decode: unsupported pixel format for "
+    "computing statistics";
+
+// Returns the orientation tag (1 to 8) of the given EXIF metadata, which is a
+// TIFF structure optionally prefixed with the "Exif\0\0" APP1 header. Returns
+// 1 (the identity) if the tag is missing or the metadata is malformed.
+inline uint32_t ParseExifOrientation(const uint8_t* data, size_t size) {
+  static const uint8_t kExifHeader[] = {'E', 'x', 'i', 'f', 0, 0};
+  if ((size >= sizeof(kExifHeader)) &&
+      (std::memcmp(data, kExifHeader, sizeof(kExifHeader)) == 0)) {
+    data += sizeof(kExifHeader);
+    size -= sizeof(kExifHeader);
+  }
+  if ((size < 8) || (data[0] != data[1]) ||
+      ((data[0] != 'I') && (data[0] != 'M'))) {
+    return 1;
+  }
+  const bool big_endian = (data[0] == 'M');
+  const auto u16 = [&](uint64_t pos) -> uint32_t {
+    return big_endian ? ((data[pos] << 8) | data[pos + 1])
+                      : (data[pos] | (data[pos + 1] << 8));
+  };
+  const auto u32 = [&](uint64_t pos) -> uint64_t {
+    const uint64_t hi = u16(pos + (big_endian ? 0 : 2));
+    const uint64_t lo = u16(pos + (big_endian ? 2 : 0));
+    return (hi << 16) | lo;
+  };
+  if (u16(2) != 42) {
+    return 1;
+  }
+  // IFD0 entries are 12 bytes long: tag, type, count and value
+  const uint64_t ifd = u32(4);
+  if (ifd + 2 > size) {
+    return 1;
+  }
+  const uint64_t num_entries = u16(ifd);
+  for (uint64_t entry = ifd + 2;
+       (entry < ifd + 2 + num_entries * 12) && (entry + 12 <= size);
+       entry += 12) {
+    // Orientation, SHORT
+    if ((u16(entry) == 0x0112) && (u16(entry + 2) == 3)) {
+      const uint32_t orientation = u16(entry + 8);
+      return ((orientation >= 1) && (orientation <= 8)) ? orientation : 1;
+    }
+  }
+  return 1;
+}
+
+// Returns the EXIF orientation tag (1 to 8) of the given JPEG data, found in
+// its APP1 "Exif\0\0" segment, which may be truncated (e.g. if the data is
+// only a prefix of the file) as long as it holds the tag. Returns 1 if there is
+// no such segment before the image data.
+inline uint32_t ParseJpegExifOrientation(const uint8_t* data, size_t size) {
+  static const uint8_t kExifHeader[] = {'E', 'x', 'i', 'f', 0, 0};
+  if ((size < 2) || (data[0] != 0xFF) || (data[1] != 0xD8)) {
+    return 1;
+  }
+  size_t pos = 2;
+  while ((pos + 4 <= size) && (data[pos] == 0xFF)) {
+    const uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) {
+      // Fill byte
+      pos++;
+      continue;
+    } else if ((marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD7))) {
+      // Markers without a length
+      pos += 2;
+      continue;
+    } else if ((marker == 0xD9) || (marker == 0xDA)) {
+      // End of image or start of scan
+      break;
+    }
+    const size_t length = (data[pos + 2] << 8) | data[pos + 3];
+    if (length < 2) {
+      break;
+    }
+    const uint8_t* segment = data + pos + 4;
+    const size_t segment_size = std::min(length - 2, size - (pos + 4));
+    if ((marker == 0xE1) && (segment_size >= sizeof(kExifHeader)) &&
+        (std::memcmp(segment, kExifHeader, sizeof(kExifHeader)) == 0)) {
+      return ParseExifOrientation(segment, segment_size);
+    }
+    pos += 2 + length;
+  }
+  return 1;
+}
 
 class ImageDecoder : public wuffs_aux::DecodeImageCallbacks {
  public:
@@ -246,7 +433,10 @@ class ImageDecoder : public wuffs_aux::DecodeImageCallbacks {
         pixel_format_(wuffs_base__make_pixel_format(config.pixel_format)),
         quirks_(wuffs_aux::DecodeImageArgQuirks(quirks_vector_.data(),
                                                 quirks_vector_.size())),
-        flags_(GetFlagsBitmask(config.flags)),
+        flags_(GetFlagsBitmask(config.flags) |
+               (config.apply_exif_orientation
+                    ? wuffs_aux::DecodeImageArgFlags::REPORT_METADATA_EXIF
+                    : 0)),
         pixel_blend_(wuffs_aux::DecodeImageArgPixelBlend(
             static_cast<uint32_t>(config.pixel_blend))),
         background_color_(
@@ -255,24 +445,62 @@ class ImageDecoder : public wuffs_aux::DecodeImageCallbacks {
             config.max_incl_dimension)),
         max_incl_metadata_length_(
             wuffs_aux::DecodeImageArgMaxInclMetadataLength(
-                config.max_incl_metadata_length)) {}
+                config.max_incl_metadata_length)),
+        compression_(config.compression),
+        collect_stats_(config.collect_stats),
+        crop_(config.crop),
+        apply_exif_orientation_(config.apply_exif_orientation),
+        report_exif_((GetFlagsBitmask(config.flags) &
+                      wuffs_aux::DecodeImageArgFlags::REPORT_METADATA_EXIF) !=
+                     0),
+        compute_(GetStatisticsBitmask(config.compute)),
+        return_pixbuf_(config.return_pixbuf) {}
 
   /* DecodeImageCallbacks methods implementation */
 
   wuffs_base__image_decoder::unique_ptr SelectDecoder(
       uint32_t fourcc, wuffs_base__slice_u8 prefix_data,
       bool prefix_closed) override {
+    fourcc_ = fourcc;
     if (enabled_decoders_.count(static_cast<ImageDecoderType>(fourcc)) == 0) {
       return {nullptr};
     }
-    return wuffs_aux::DecodeImageCallbacks::SelectDecoder(fourcc, prefix_data,
-                                                          prefix_closed);
+    const Clock::time_point start =
+        collect_stats_ ? Clock::now() : Clock::time_point();
+    // The Wuffs JPEG decoder doesn't report the EXIF metadata, so the
+    // orientation is read from the APP1 segment in the sniffed prefix
+    if (apply_exif_orientation_ && (fourcc == WUFFS_BASE__FOURCC__JPEG)) {
+      orientation_ = ParseJpegExifOrientation(prefix_data.ptr, prefix_data.len);
+    }
+    wuffs_base__image_decoder::unique_ptr decoder =
+        wuffs_aux::DecodeImageCallbacks::SelectDecoder(fourcc, prefix_data,
+                                                       prefix_closed);
+    if (collect_stats_ && decoder) {
+      select_decoder_start_ = start;
+      select_decoder_end_ = Clock::now();
+    }
+    return decoder;
   }
 
   std::string HandleMetadata(const wuffs_base__more_information& minfo,
                              wuffs_base__slice_u8 raw) override {
-    decoding_result_.reported_metadata.emplace_back(
-        minfo, std::vector<uint8_t>{raw.ptr, raw.ptr + raw.len});
+    const Clock::time_point start =
+        collect_stats_ ? Clock::now() : Clock::time_point();
+    const bool is_exif =
+        (minfo.flavor ==
+         WUFFS_BASE__MORE_INFORMATION__FLAVOR__METADATA_RAW_PASSTHROUGH) &&
+        (minfo.metadata__fourcc() == WUFFS_BASE__FOURCC__EXIF);
+    if (is_exif && apply_exif_orientation_) {
+      orientation_ = ParseExifOrientation(raw.ptr, raw.len);
+    }
+    // EXIF is also requested for apply_exif_orientation
+    if (!is_exif || report_exif_) {
+      decoding_result_.reported_metadata.emplace_back(
+          minfo, std::vector<uint8_t>{raw.ptr, raw.ptr + raw.len});
+    }
+    if (collect_stats_) {
+      metadata_duration_ += Clock::now() - start;
+    }
     return "";
   }
 
@@ -281,41 +509,25 @@ class ImageDecoder : public wuffs_aux::DecodeImageCallbacks {
     return pixel_format_;
   }
 
-  // This implementation is essentially the same as the default one except that
-  // it uses the "decoding_result_" field for allocating output buffer
+  // Times AllocPixbufInternal for the stats
   AllocPixbufResult AllocPixbuf(const wuffs_base__image_config& image_config,
                                 bool allow_uninitialized_memory) override {
-    uint32_t w = image_config.pixcfg.width();
-    uint32_t h = image_config.pixcfg.height();
-    if ((w == 0) || (h == 0)) {
-      return {""};
-    }
-    uint64_t len = image_config.pixcfg.pixbuf_len();
-    if (len == 0 || SIZE_MAX < len) {
-      return {wuffs_aux::DecodeImage_UnsupportedPixelConfiguration};
+    if (collect_stats_) {
+      alloc_pixbuf_start_ = Clock::now();
     }
-    decoding_result_.pixbuf.resize(len);
-    if (!allow_uninitialized_memory) {
-      std::memset(decoding_result_.pixbuf.data(), 0,
-                  decoding_result_.pixbuf.size());
-    }
-    wuffs_base__pixel_buffer pixbuf;
-    wuffs_base__status status = pixbuf.set_from_slice(
-        &image_config.pixcfg,
-        wuffs_base__make_slice_u8(decoding_result_.pixbuf.data(),
-                                  decoding_result_.pixbuf.size()));
-    if (!status.is_ok()) {
-      decoding_result_.pixbuf = {};
-      return {status.message()};
+    AllocPixbufResult result =
+        AllocPixbufInternal(image_config, allow_uninitialized_memory);
+    if (collect_stats_) {
+      alloc_pixbuf_end_ = Clock::now();
     }
-    return {wuffs_aux::MemOwner(nullptr, &free), pixbuf};
+    return result;
   }
 
   /* End of DecodeImageCallbacks methods implementation */
 
   ImageDecodingResult Decode(const uint8_t* data, size_t size) {
     wuffs_aux::sync_io::MemoryInput input(data, size);
-    return DecodeInternal(input);
+    return DecodeInternal(input, [size]() { return size; });
   }
 
   ImageDecodingResult Decode(const std::string& path_to_file) {
@@ -326,11 +538,24 @@ class ImageDecoder : public wuffs_aux::DecodeImageCallbacks {
       return result;
     }
     wuffs_aux::sync_io::FileInput input(f);
-    ImageDecodingResult result = DecodeInternal(input);
+    // The number of bytes read from the file
+    ImageDecodingResult result = DecodeInternal(input, [f]() {
+      const long position = ftell(f);
+      return position > 0 ? static_cast<uint64_t>(position) : 0;
+    });
     fclose(f);
     return result;
   }
 
+  // Decodes from the given input, e.g. a Python file-like object. The
+  // get_input_bytes function returns the number of bytes read from it once
+  // decoding is done.
+  template <typename GetInputBytes>
+  ImageDecodingResult Decode(wuffs_aux::sync_io::Input& input,
+                             const GetInputBytes& get_input_bytes) {
+    return DecodeInternal(input, get_input_bytes);
+  }
+
  private:
   static uint64_t GetFlagsBitmask(const std::vector<ImageDecoderFlags>& flags) {
     uint64_t bitmask = 0;
@@ -340,10 +565,232 @@ class ImageDecoder : public wuffs_aux::DecodeImageCallbacks {
     return bitmask;
   }
 
-  ImageDecodingResult DecodeInternal(wuffs_aux::sync_io::Input& input) {
+  static uint32_t GetStatisticsBitmask(
+      const std::vector<ImageStatistic>& statistics) {
+    uint32_t bitmask = 0;
+    for (const auto s : statistics) {
+      bitmask |= ImageStatisticBit(s);
+    }
+    return bitmask;
+  }
+
+  bool is_cropping() const { return (crop_[2] != 0) && (crop_[3] != 0); }
+
+  bool is_transforming() const { return is_cropping() || (orientation_ != 1); }
+
+  // This implementation is essentially the same as the default one except that
+  // it uses the "decoding_result_" field for allocating output buffer. When
+  // cropping or orienting (the EXIF metadata is handled before the pixel
+  // buffer allocation), the whole frame is decoded into the "frame_pixbuf_"
+  // field, which is reused by the following decodes, and the result is copied
+  // out of it by Transform. The same goes when the pixels are not returned.
+  AllocPixbufResult AllocPixbufInternal(
+      const wuffs_base__image_config& image_config,
+      bool allow_uninitialized_memory) {
+    uint32_t w = image_config.pixcfg.width();
+    uint32_t h = image_config.pixcfg.height();
+    if ((w == 0) || (h == 0)) {
+      return {""};
+    }
+    uint64_t len = image_config.pixcfg.pixbuf_len();
+    if (len == 0 || SIZE_MAX < len) {
+      return {wuffs_aux::DecodeImage_UnsupportedPixelConfiguration};
+    }
+    std::vector<uint8_t>& buffer =
+        (is_transforming() || !return_pixbuf_) ? frame_pixbuf_
+                                               : decoding_result_.pixbuf;
+    buffer.resize(len);
+    if (!allow_uninitialized_memory) {
+      std::memset(buffer.data(), 0, buffer.size());
+    }
+    wuffs_base__pixel_buffer pixbuf;
+    wuffs_base__status status = pixbuf.set_from_slice(
+        &image_config.pixcfg,
+        wuffs_base__make_slice_u8(buffer.data(), buffer.size()));
+    if (!status.is_ok()) {
+      buffer = {};
+      return {status.message()};
+    }
+    return {wuffs_aux::MemOwner(nullptr, &free), pixbuf};
+  }
+
+  // Maps a pixel of the oriented frame to the decoded frame of the given size.
+  static std::pair<uint64_t, uint64_t> SourcePoint(uint32_t orientation,
+                                                   uint64_t w, uint64_t h,
+                                                   uint64_t x, uint64_t y) {
+    switch (orientation) {
+      case 2:  // Mirrored horizontally
+        return {w - 1 - x, y};
+      case 3:  // Rotated 180 degrees
+        return {w - 1 - x, h - 1 - y};
+      case 4:  // Mirrored vertically
+        return {x, h - 1 - y};
+      case 5:  // Transposed
+        return {y, x};
+      case 6:  // Rotated 90 degrees clockwise
+        return {y, h - 1 - x};
+      case 7:  // Transversed
+        return {w - 1 - y, h - 1 - x};
+      case 8:  // Rotated 90 degrees counterclockwise
+        return {w - 1 - y, x};
+    }
+    return {x, y};
+  }
+
+  // Copies the width x height pixels at src to dst, the pixel (x, y) going to
+  // dst + x * dx + y * dy. The copy goes by square tiles, so that both the
+  // source and the destination rows stay in cache when transposing.
+  template <size_t kBytesPerPixel>
+  static void CopyPixels(const uint8_t* src, size_t src_stride, size_t width,
+                         size_t height, size_t bytes_per_pixel, uint8_t* dst,
+                         ptrdiff_t dx, ptrdiff_t dy) {
+    constexpr size_t kTileSize = 64;
+    const size_t bpp = kBytesPerPixel ? kBytesPerPixel : bytes_per_pixel;
+    for (size_t y0 = 0; y0 < height; y0 += kTileSize) {
+      const size_t y1 = std::min(height, y0 + kTileSize);
+      for (size_t x0 = 0; x0 < width; x0 += kTileSize) {
+        const size_t x1 = std::min(width, x0 + kTileSize);
+        for (size_t y = y0; y < y1; y++) {
+          const uint8_t* s = src + y * src_stride + x0 * bpp;
+          uint8_t* d = dst + static_cast<ptrdiff_t>(y) * dy +
+                       static_cast<ptrdiff_t>(x0) * dx;
+          for (size_t x = x0; x < x1; x++, s += bpp, d += dx) {
+            std::memcpy(d, s, bpp);
+          }
+        }
+      }
+    }
+  }
+
+  // Copies the decoded frame to the result pixel buffer in a single pass,
+  // applying the EXIF orientation and then the crop, i.e. only the source
+  // pixels of the region of interest are read.
+  void Transform() {
+    const wuffs_base__pixel_config& frame_pixcfg = decoding_result_.pixcfg;
+    const uint64_t w = frame_pixcfg.width();
+    const uint64_t h = frame_pixcfg.height();
+    const bool transposed = (orientation_ >= 5);
+    // The region of interest in the oriented frame
+    uint64_t x0 = 0;
+    uint64_t y0 = 0;
+    uint64_t x1 = transposed ? h : w;
+    uint64_t y1 = transposed ? w : h;
+    if (is_cropping()) {
+      x0 = std::min<uint64_t>(crop_[0], x1);
+      y0 = std::min<uint64_t>(crop_[1], y1);
+      x1 = std::min<uint64_t>(static_cast<uint64_t>(crop_[0]) + crop_[2], x1);
+      y1 = std::min<uint64_t>(static_cast<uint64_t>(crop_[1]) + crop_[3], y1);
+    }
+    if ((x0 == x1) || (y0 == y1)) {
+      decoding_result_.error_message = ImageDecoderError::CropOutOfBounds;
+      decoding_result_.pixbuf = {};
+      decoding_result_.pixcfg = wuffs_base__null_pixel_config();
+      return;
+    }
+    // The region of interest in the decoded frame
+    const std::pair<uint64_t, uint64_t> corner0 =
+        SourcePoint(orientation_, w, h, x0, y0);
+    const std::pair<uint64_t, uint64_t> corner1 =
+        SourcePoint(orientation_, w, h, x1 - 1, y1 - 1);
+    const uint64_t sx = std::min(corner0.first, corner1.first);
+    const uint64_t sy = std::min(corner0.second, corner1.second);
+    const uint64_t sw = std::max(corner0.first, corner1.first) - sx + 1;
+    const uint64_t sh = std::max(corner0.second, corner1.second) - sy + 1;
+
+    const size_t bytes_per_pixel =
+        frame_pixcfg.pixel_format().bits_per_pixel() / 8;
+    const size_t frame_stride = w * bytes_per_pixel;
+    const size_t stride = (x1 - x0) * bytes_per_pixel;
+    decoding_result_.pixbuf.resize(stride * (y1 - y0));
+    const uint8_t* src =
+        frame_pixbuf_.data() + sy * frame_stride + sx * bytes_per_pixel;
+    uint8_t* dst = decoding_result_.pixbuf.data();
+    if (orientation_ == 1) {
+      for (; dst < decoding_result_.pixbuf.data() +
+                       decoding_result_.pixbuf.size();
+           dst += stride, src += frame_stride) {
+        std::memcpy(dst, src, stride);
+      }
+    } else {
+      // Where the decoded pixels (0, 0), (1, 0) and (0, 1) go
+      const ptrdiff_t b = bytes_per_pixel;
+      const ptrdiff_t s = stride;
+      ptrdiff_t origin = 0;
+      ptrdiff_t dx = b;
+      ptrdiff_t dy = s;
+      switch (orientation_) {
+        case 2:
+          origin = (sw - 1) * b;
+          dx = -b;
+          dy = s;
+          break;
+        case 3:
+          origin = (sh - 1) * s + (sw - 1) * b;
+          dx = -b;
+          dy = -s;
+          break;
+        case 4:
+          origin = (sh - 1) * s;
+          dx = b;
+          dy = -s;
+          break;
+        case 5:
+          dx = s;
+          dy = b;
+          break;
+        case 6:
+          origin = (sh - 1) * b;
+          dx = s;
+          dy = -b;
+          break;
+        case 7:
+          origin = (sw - 1) * s + (sh - 1) * b;
+          dx = -s;
+          dy = -b;
+          break;
+        case 8:
+          origin = (sw - 1) * s;
+          dx = -s;
+          dy = b;
+          break;
+      }
+      switch (bytes_per_pixel) {
+#define CPBPP(bpp)                                                      \
+  case bpp:                                                             \
+    CopyPixels<bpp>(src, frame_stride, sw, sh, bpp, dst + origin, dx,   \
+                    dy);                                                \
+    break
+        CPBPP(1);
+        CPBPP(2);
+        CPBPP(3);
+        CPBPP(4);
+        CPBPP(8);
+#undef CPBPP
+        default:
+          CopyPixels<0>(src, frame_stride, sw, sh, bytes_per_pixel,
+                        dst + origin, dx, dy);
+      }
+    }
+    decoding_result_.pixcfg.set(frame_pixcfg.pixel_format().repr,
+                                frame_pixcfg.pixel_subsampling().repr,
+                                static_cast<uint32_t>(x1 - x0),
+                                static_cast<uint32_t>(y1 - y0));
+  }
+
+  // GetInputBytes returns the number of input bytes once decoding is done.
+  template <typename GetInputBytes>
+  ImageDecodingResult DecodeInternal(wuffs_aux::sync_io::Input& input,
+                                     const GetInputBytes& get_input_bytes) {
+    const Clock::time_point start = Clock::now();
+    fourcc_ = 0;
+    select_decoder_start_ = select_decoder_end_ = Clock::time_point();
+    alloc_pixbuf_start_ = alloc_pixbuf_end_ = Clock::time_point();
+    metadata_duration_ = Clock::duration::zero();
+    orientation_ = 1;
+    DecompressingInput decompressing_input(compression_, input);
     wuffs_aux::DecodeImageResult decode_image_result = wuffs_aux::DecodeImage(
-        *this, input, quirks_, flags_, pixel_blend_, background_color_,
-        max_incl_dimension_, max_incl_metadata_length_);
+        *this, decompressing_input.Get(), quirks_, flags_, pixel_blend_,
+        background_color_, max_incl_dimension_, max_incl_metadata_length_);
     decoding_result_.error_message =
         std::move(decode_image_result.error_message);
     if (!decode_image_result.pixbuf.pixcfg.is_valid()) {
@@ -351,10 +798,85 @@ class ImageDecoder : public wuffs_aux::DecodeImageCallbacks {
       decoding_result_.pixcfg = wuffs_base__null_pixel_config();
     } else {
       decoding_result_.pixcfg = decode_image_result.pixbuf.pixcfg;
+      if (is_transforming()) {
+        Transform();
+      }
+    }
+    const Clock::time_point pixels_end = Clock::now();
+    if (compute_ && decoding_result_.pixcfg.is_valid()) {
+      ComputeStatistics();
+    }
+    if (!return_pixbuf_) {
+      decoding_result_.pixbuf = {};
+    }
+    const Clock::time_point end = Clock::now();
+    const uint64_t input_bytes = get_input_bytes();
+    Metrics::Record(ImageDecoderTypeName(fourcc_), input_bytes,
+                    SecondsBetween(start, end),
+                    ErrorMetricsKey(decoding_result_.error_message,
+                                    {&ImageDecoderError::FailedToReadFile}));
+    if (collect_stats_) {
+      FillStats(start, pixels_end, end, input_bytes);
     }
     return std::move(decoding_result_);
   }
 
+  // Computes the requested statistics over the output pixels, which are in
+  // the result pixel buffer unless they were neither transformed nor
+  // returned.
+  void ComputeStatistics() {
+    const wuffs_base__pixel_config& pixcfg = decoding_result_.pixcfg;
+    const std::vector<uint8_t>& pixels =
+        (is_transforming() || return_pixbuf_) ? decoding_result_.pixbuf
+                                              : frame_pixbuf_;
+    const size_t stride =
+        pixcfg.width() * (pixcfg.pixel_format().bits_per_pixel() / 8);
+    if (!ImageStatisticsComputer::Compute(
+            pixels.data(), pixcfg.width(), pixcfg.height(), stride,
+            pixcfg.pixel_format().repr, compute_,
+            decoding_result_.statistics)) {
+      decoding_result_.error_message =
+          ImageDecoderError::UnsupportedStatisticsPixelFormat;
+      decoding_result_.pixbuf = {};
+      decoding_result_.pixcfg = wuffs_base__null_pixel_config();
+    }
+  }
+
+  // Splits the decode into the phases of wuffs_aux::DecodeImage: sniffing the
+  // format, creating the decoder, decoding the header (the metadata handling
+  // excluded), allocating the pixel buffer and decoding the pixels, then
+  // computing the statistics, if any. A failed decode only reports the phases
+  // it started.
+  void FillStats(Clock::time_point start, Clock::time_point pixels_end,
+                 Clock::time_point end, uint64_t input_bytes) {
+    DecodingStats& stats = decoding_result_.stats;
+    stats = DecodingStats();
+    stats.input_bytes = input_bytes;
+    stats.output_bytes = decoding_result_.pixbuf.size();
+    const Clock::time_point unset;
+    if (select_decoder_end_ == unset) {
+      stats.AddPhase("sniff", start, end);
+      return;
+    }
+    stats.AddPhase("sniff", start, select_decoder_start_);
+    stats.AddPhase("select_decoder", select_decoder_start_,
+                   select_decoder_end_);
+    const Clock::time_point header_end =
+        (alloc_pixbuf_start_ == unset) ? end : alloc_pixbuf_start_;
+    stats.AddPhase("header", select_decoder_end_,
+                   header_end - metadata_duration_);
+    if (!decoding_result_.reported_metadata.empty()) {
+      stats.AddPhase("metadata", header_end - metadata_duration_, header_end);
+    }
+    if (alloc_pixbuf_start_ != unset) {
+      stats.AddPhase("alloc_pixbuf", alloc_pixbuf_start_, alloc_pixbuf_end_);
+      stats.AddPhase("pixels", alloc_pixbuf_end_, pixels_end);
+    }
+    if (decoding_result_.statistics.computed != 0) {
+      stats.AddPhase("statistics", pixels_end, end);
+    }
+  }
+
  private:
   ImageDecodingResult decoding_result_;
   std::vector<wuffs_aux::QuirkKeyValuePair> quirks_vector_;
@@ -366,6 +888,24 @@ class ImageDecoder : public wuffs_aux::DecodeImageCallbacks {
   wuffs_aux::DecodeImageArgBackgroundColor background_color_;
   wuffs_aux::DecodeImageArgMaxInclDimension max_incl_dimension_;
   wuffs_aux::DecodeImageArgMaxInclMetadataLength max_incl_metadata_length_;
+  InputCompression compression_;
+  bool collect_stats_;
+  std::array<uint32_t, 4> crop_;
+  bool apply_exif_orientation_;
+  // Whether the EXIF metadata was requested by the flags
+  bool report_exif_;
+  // Bitmask of the statistics to compute (see ImageStatisticBit)
+  uint32_t compute_;
+  bool return_pixbuf_;
+  std::vector<uint8_t> frame_pixbuf_;
+  // The state of the current decode, for the metrics and the stats
+  uint32_t fourcc_ = 0;
+  uint32_t orientation_ = 1;
+  Clock::time_point select_decoder_start_;
+  Clock::time_point select_decoder_end_;
+  Clock::time_point alloc_pixbuf_start_;
+  Clock::time_point alloc_pixbuf_end_;
+  Clock::duration metadata_duration_ = Clock::duration::zero();
 };
 
 }  // namespace wuffs_aux_wrap
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "wuffs-aux-codecs.h"
+
+// This header holds the parts of the decompression API which don't depend on
+// pybind11: creating the Wuffs decoders for compression formats and the
+// decompressing wuffs_aux::sync_io::Input used by the JSON and image decoders.
+
+namespace wuffs_aux_wrap {
+
+enum class DecompressorType : uint32_t { DEFLATE, GZIP, ZLIB, BZIP2, LZMA, XZ };
+
+// Compression of the JSON and image decoders input
+enum class InputCompression : uint32_t {
+  NONE,
+  DEFLATE,
+  GZIP,
+  ZLIB,
+  BZIP2,
+  LZMA,
+  XZ
+};
+
+struct DecompressorError {
+  static const std::string MaxOutputSizeExceeded;
+  static const std::string UnexpectedEndOfFile;
+  static const std::string OutOfMemory;
+  static const std::string UnsupportedDecompressorType;
+};
+
+const std::string DecompressorError::MaxOutputSizeExceeded =
+    "wuffs_aux_wrap::Decompressor: max output size exceeded";
+const std::string DecompressorError::UnexpectedEndOfFile =
+    "wuffs_aux_wrap::Decompressor: unexpected end of file";
+const std::string DecompressorError::OutOfMemory =
+    "wuffs_aux_wrap::Decompressor: out of memory";
+const std::string DecompressorError::UnsupportedDecompressorType =
+    "wuffs_aux_wrap::Decompressor: unsupported decompressor type";
+
+// Creates the Wuffs decoder of given type and applies the quirks to it. On
+// failure (including the type not being compiled in, see
+// wuffs-aux-codecs.h), returns nullptr and sets the error message.
+inline wuffs_base__io_transformer::unique_ptr CreateIoTransformer(
+    DecompressorType type,
+    const std::vector<wuffs_aux::QuirkKeyValuePair>& quirks_vector,
+    std::string& error_message) {
+  wuffs_base__io_transformer::unique_ptr transformer(nullptr);
+  switch (type) {
+#if defined(PYWUFFS_CODEC_DEFLATE)
+    case DecompressorType::DEFLATE:
+      transformer =
+          wuffs_deflate__decoder::alloc_as__wuffs_base__io_transformer();
+      break;
+#endif
+#if defined(PYWUFFS_CODEC_GZIP)
+    case DecompressorType::GZIP:
+      transformer = wuffs_gzip__decoder::alloc_as__wuffs_base__io_transformer();
+      break;
+#endif
+#if defined(PYWUFFS_CODEC_ZLIB)
+    case DecompressorType::ZLIB:
+      transformer = wuffs_zlib__decoder::alloc_as__wuffs_base__io_transformer();
+      break;
+#endif
+#if defined(PYWUFFS_CODEC_BZIP2)
+    case DecompressorType::BZIP2:
+      transformer =
+          wuffs_bzip2__decoder::alloc_as__wuffs_base__io_transformer();
+      break;
+#endif
+#if defined(PYWUFFS_CODEC_LZMA)
+    case DecompressorType::LZMA:
+      transformer = wuffs_lzma__decoder::alloc_as__wuffs_base__io_transformer();
+      break;
+#endif
+#if defined(PYWUFFS_CODEC_XZ)
+    case DecompressorType::XZ:
+      transformer = wuffs_xz__decoder::alloc_as__wuffs_base__io_transformer();
+      break;
+#endif
+    default:
+      error_message = DecompressorError::UnsupportedDecompressorType;
+      return transformer;
+  }
+  if (!transformer) {
+    error_message = DecompressorError::OutOfMemory;
+    return transformer;
+  }
+  for (const auto& quirk : quirks_vector) {
+    const wuffs_base__status status =
+        transformer->set_quirk(quirk.first, quirk.second);
+    if (!status.is_ok()) {
+      error_message = status.message();
+      return wuffs_base__io_transformer::unique_ptr(nullptr);
+    }
+  }
+  return transformer;
+}
+
+// This class implements wuffs_aux::sync_io::Input by decompressing another
+// input on the fly, so that the JSON and image decoders never hold the whole
+// decompressed payload. The Wuffs decoders keep their history internally
+// (their dst_history_retain_length is 0), so the decompressed data is written
+// straight into the consumer's buffer.
+class DecompressingInput : public wuffs_aux::sync_io::Input {
+ public:
+  DecompressingInput(InputCompression compression,
+                     wuffs_aux::sync_io::Input& source)
+      : compression_(compression),
+        source_(source),
+        src_(source.BringsItsOwnIOBuffer()) {
+    if (compression_ == InputCompression::NONE) {
+      return;
+    }
+    transformer_ = CreateIoTransformer(ToDecompressorType(compression_), {},
+                                       error_message_);
+    if (!src_) {
+      src_array_.resize(kSrcBufferSize);
+      own_src_ =
+          wuffs_base__ptr_u8__writer(src_array_.data(), src_array_.size());
+      src_ = &own_src_;
+    }
+  }
+
+  DecompressingInput(const DecompressingInput& other) = delete;
+  DecompressingInput& operator=(const DecompressingInput& other) = delete;
+
+  // Returns the input to decode: this one if the source is compressed, the
+  // source itself otherwise.
+  wuffs_aux::sync_io::Input& Get() {
+    if (compression_ == InputCompression::NONE) {
+      return source_;
+    }
+    return *this;
+  }
+
+  std::string CopyIn(wuffs_aux::IOBuffer* dst) override {
+    if (!error_message_.empty()) {
+      return error_message_;
+    } else if (!dst) {
+      return "wuffs_aux_wrap::DecompressingInput: nullptr IOBuffer";
+    } else if (dst->meta.closed) {
+      return "wuffs_aux_wrap::DecompressingInput: end of file";
+    }
+    dst->compact();
+    const size_t initial_wi = dst->meta.wi;
+    while (true) {
+      // The work buffer length may depend on the stream header
+      const uint64_t workbuf_length = transformer_->workbuf_len().max_incl;
+      if (workbuf_length > SIZE_MAX) {
+        return DecompressorError::OutOfMemory;
+      } else if (workbuf_.size() < workbuf_length) {
+        workbuf_.resize(static_cast<size_t>(workbuf_length));
+      }
+      const wuffs_base__status status = transformer_->transform_io(
+          dst, src_,
+          wuffs_base__make_slice_u8(workbuf_.data(), workbuf_.size()));
+      if (status.repr == nullptr) {
+        dst->meta.closed = true;
+        return "";
+      } else if (status.repr == wuffs_base__suspension__short_write) {
+        return "";
+      } else if (status.repr != wuffs_base__suspension__short_read) {
+        return status.message();
+      } else if (src_->meta.closed) {
+        return DecompressorError::UnexpectedEndOfFile;
+      } else if (dst->meta.wi > initial_wi) {
+        // Hand over the data decompressed so far before reading more
+        return "";
+      }
+      std::string error_message = source_.CopyIn(src_);
+      if (!error_message.empty()) {
+        return error_message;
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kSrcBufferSize = 64 * 1024;
+
+  static DecompressorType ToDecompressorType(InputCompression compression) {
+    switch (compression) {
+      case InputCompression::DEFLATE:
+        return DecompressorType::DEFLATE;
+      case InputCompression::ZLIB:
+        return DecompressorType::ZLIB;
+      case InputCompression::BZIP2:
+        return DecompressorType::BZIP2;
+      case InputCompression::LZMA:
+        return DecompressorType::LZMA;
+      case InputCompression::XZ:
+        return DecompressorType::XZ;
+      default:
+        return DecompressorType::GZIP;
+    }
+  }
+
+  InputCompression compression_;
+  wuffs_aux::sync_io::Input& source_;
+  wuffs_aux::IOBuffer* src_;
+  std::vector<uint8_t> src_array_;
+  wuffs_aux::IOBuffer own_src_ = wuffs_base__empty_io_buffer();
+  wuffs_base__io_transformer::unique_ptr transformer_{nullptr};
+  std::vector<uint8_t> workbuf_;
+  std::string error_message_;
+};
+
+}  // namespace wuffs_aux_wrap
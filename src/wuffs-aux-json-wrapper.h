@@ -1,14 +1,26 @@
 #pragma once
 
 #include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
 #include <pybind11/pytypes.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
-#include <wuffs-unsupported-snapshot.c>
 
+#include "wuffs-aux-codecs.h"
+#include "wuffs-aux-io-transformer.h"
+#include "wuffs-aux-metrics.h"
+#include "wuffs-aux-python-input.h"
 #include "wuffs-aux-utils.h"
 
 // This API wraps the wuffs_aux API for JSON decoding. The wrapper is needed
@@ -44,17 +56,34 @@ enum class JsonDecoderQuirks : uint32_t {
 #undef JDQE
 };
 
+// Column types for JsonDecoder::DecodeColumnar
+enum class JsonColumnType : uint32_t { BOOL, INT64, FLOAT64, STRING, OBJECT };
+
+// Ordered list of (field name, column type) pairs
+using JsonColumnarSchema = std::vector<std::pair<std::string, JsonColumnType>>;
+
 // This struct hosts wuffs_aux::DecodeJson arguments in more user- and
 // Python- friendly fashion
 struct JsonDecoderConfig {
   std::map<JsonDecoderQuirks, uint64_t> quirks;
   std::string json_pointer;
+  std::vector<std::string> json_pointers;
+  // If non-zero, arrays of numbers (and nested arrays of equally shaped
+  // arrays of numbers, up to this number of dimensions) are decoded into
+  // float64/int64 NumPy arrays
+  uint32_t numeric_array_max_ndim = 0;
+  // Compression of the input, which is decompressed on the fly
+  InputCompression compression = InputCompression::NONE;
+  // If true, the decoding results hold the timing breakdown of the decode
+  bool collect_stats = false;
 };
 
 struct JsonDecodingResult {
   pybind11::object parsed;
   std::string error_message;
   uint64_t cursor_position = 0;
+  // Only filled if JsonDecoderConfig::collect_stats is set
+  DecodingStats stats;
 
   JsonDecodingResult() = default;
 
@@ -62,6 +91,7 @@ struct JsonDecodingResult {
     std::swap(parsed, other.parsed);
     std::swap(error_message, other.error_message);
     std::swap(cursor_position, other.cursor_position);
+    std::swap(stats, other.stats);
   }
 
   JsonDecodingResult& operator=(JsonDecodingResult&& other) noexcept {
@@ -69,6 +99,7 @@ struct JsonDecodingResult {
       std::swap(parsed, other.parsed);
       std::swap(error_message, other.error_message);
       std::swap(cursor_position, other.cursor_position);
+      std::swap(stats, other.stats);
     }
     return *this;
   }
@@ -77,6 +108,14 @@ struct JsonDecodingResult {
   JsonDecodingResult& operator=(JsonDecodingResult& other) = delete;
 };
 
+// The metrics registry key of all the JSON decodes
+const char* const kJsonMetricsName = "JSON";
+
+struct JsonValidationResult {
+  std::string error_message;
+  uint64_t cursor_position = 0;
+};
+
 struct JsonDecoderError {
   static const std::string BadJsonPointer;
   static const std::string NoMatch;
@@ -85,6 +124,9 @@ struct JsonDecoderError {
   static const std::string NonContainerStackEntry;
   static const std::string BadDepth;
   static const std::string FailedToOpenFile;
+  static const std::string FailedToReadFile;
+  static const std::string NonRecordArray;
+  static const std::string BadColumnType;
   static const std::string BadC0ControlCode;
   static const std::string BadUtf8;
   static const std::string BadBackslashEscape;
@@ -108,6 +150,13 @@ const std::string JsonDecoderError::BadDepth =
     "wuffs_aux_wrap::JsonDecoder::Decode: bad depth";
 const std::string JsonDecoderError::FailedToOpenFile =
     "wuffs_aux_wrap::JsonDecoder::Decode: failed to open file";
+const std::string JsonDecoderError::FailedToReadFile =
+    "wuffs_aux_wrap::JsonDecoder::Decode: failed to read file";
+const std::string JsonDecoderError::NonRecordArray =
+    "wuffs_aux_wrap::JsonDecoder::DecodeColumnar: not an array of objects";
+const std::string JsonDecoderError::BadColumnType =
+    "wuffs_aux_wrap::JsonDecoder::DecodeColumnar: value doesn't match column "
+    "type: key=";
 // + 1 is for stripping leading '#'
 const std::string JsonDecoderError::BadC0ControlCode =
     wuffs_json__error__bad_c0_control_code + 1;
@@ -124,8 +173,168 @@ const std::string JsonDecoderError::UnsupportedNumberLength =
 const std::string JsonDecoderError::UnsupportedRecursionDepth =
     wuffs_json__error__unsupported_recursion_depth + 1;
 
-class JsonDecoder : public wuffs_aux::DecodeJsonCallbacks {
+// Returns the metrics key of a JSON decoding error, which drops the map keys,
+// the column names and the Python exception texts (see ErrorMetricsKey).
+inline const std::string& JsonErrorMetricsKey(
+    const std::string& error_message) {
+  return ErrorMetricsKey(error_message, {&JsonDecoderError::DuplicateMapKey,
+                                         &JsonDecoderError::BadColumnType,
+                                         &JsonDecoderError::FailedToReadFile});
+}
+
+// This class records the wuffs_aux::DecodeJsonCallbacks calls made while
+// decoding a JSON document in a compact, Python-agnostic form. It allows
+// running the Wuffs tokenizer and the number/string parsing without holding
+// the GIL, and building Python objects later on by replaying the calls.
+class JsonTape : public wuffs_aux::DecodeJsonCallbacks {
+ public:
+  void Decode(wuffs_aux::sync_io::Input& input,
+              wuffs_aux::DecodeJsonArgQuirks quirks,
+              wuffs_aux::DecodeJsonArgJsonPointer json_pointer) {
+    wuffs_aux::DecodeJsonResult decode_json_result =
+        wuffs_aux::DecodeJson(*this, input, quirks, json_pointer);
+    error_message_ = std::move(decode_json_result.error_message);
+    cursor_position_ = decode_json_result.cursor_position;
+  }
+
+  // Replays the recorded calls in order. Returns the first error returned by
+  // the callbacks, if any.
+  std::string Replay(wuffs_aux::DecodeJsonCallbacks& callbacks) const {
+    size_t string_offset = 0;
+    for (const Entry& entry : entries_) {
+      std::string error_message;
+      switch (entry.op) {
+        case Op::kNull:
+          error_message = callbacks.AppendNull();
+          break;
+        case Op::kBool:
+          error_message = callbacks.AppendBool(entry.flags != 0);
+          break;
+        case Op::kI64:
+          error_message = callbacks.AppendI64(entry.i64);
+          break;
+        case Op::kF64:
+          error_message = callbacks.AppendF64(entry.f64);
+          break;
+        case Op::kTextString:
+          error_message = callbacks.AppendTextString(
+              strings_.substr(string_offset, entry.length));
+          string_offset += entry.length;
+          break;
+        case Op::kPush:
+          error_message = callbacks.Push(entry.flags);
+          break;
+        case Op::kPop:
+          error_message = callbacks.Pop(entry.flags);
+          break;
+      }
+      if (!error_message.empty()) {
+        return error_message;
+      }
+    }
+    return "";
+  }
+
+  const std::string& error_message() const { return error_message_; }
+
+  uint64_t cursor_position() const { return cursor_position_; }
+
+  /* DecodeJsonCallbacks methods implementation */
+
+  std::string AppendNull() override {
+    entries_.emplace_back(Op::kNull, 0);
+    return "";
+  }
+
+  std::string AppendBool(bool val) override {
+    entries_.emplace_back(Op::kBool, val ? 1 : 0);
+    return "";
+  }
+
+  std::string AppendI64(int64_t val) override {
+    entries_.emplace_back(Op::kI64, 0);
+    entries_.back().i64 = val;
+    return "";
+  }
+
+  std::string AppendF64(double val) override {
+    entries_.emplace_back(Op::kF64, 0);
+    entries_.back().f64 = val;
+    return "";
+  }
+
+  std::string AppendTextString(std::string&& val) override {
+    entries_.emplace_back(Op::kTextString, 0);
+    entries_.back().length = val.size();
+    strings_.append(val);
+    return "";
+  }
+
+  std::string Push(uint32_t flags) override {
+    entries_.emplace_back(Op::kPush, flags);
+    return "";
+  }
+
+  std::string Pop(uint32_t flags) override {
+    entries_.emplace_back(Op::kPop, flags);
+    return "";
+  }
+
+  /* End of DecodeJsonCallbacks methods implementation */
+
+ private:
+  enum class Op : uint8_t {
+    kNull,
+    kBool,
+    kI64,
+    kF64,
+    kTextString,
+    kPush,
+    kPop
+  };
+
+  struct Entry {
+    Entry(Op op, uint32_t flags) : op(op), flags(flags), i64(0) {}
+
+    Op op;
+    // Holds the bool value for kBool and the flags for kPush and kPop.
+    uint32_t flags;
+    union {
+      int64_t i64;
+      double f64;
+      // The string itself is stored in strings_.
+      size_t length;
+    };
+  };
+
+  std::vector<Entry> entries_;
+  std::string strings_;
+  std::string error_message_;
+  uint64_t cursor_position_ = 0;
+};
+
+// This class implements the wuffs_aux::DecodeJsonCallbacks interface by
+// building Python objects from the decoded JSON.
+class JsonObjectBuilder : public wuffs_aux::DecodeJsonCallbacks {
  public:
+  struct Number {
+    bool is_f64;
+    union {
+      int64_t i64;
+      double f64;
+    };
+  };
+
+  // This struct buffers the contents of a JSON array consisting only of
+  // numbers (or of equally shaped numeric arrays) until it's known whether the
+  // array can be emitted as a NumPy array
+  struct NumericArray {
+    bool enabled = false;
+    // shape[0] is the number of elements, the rest is the elements' shape
+    std::vector<size_t> shape;
+    std::vector<Number> values;
+  };
+
   struct Entry {
     Entry(pybind11::object&& jvalue_arg)
         : jvalue(std::move(jvalue_arg)), has_map_key(false), map_key() {}
@@ -133,17 +342,15 @@ class JsonDecoder : public wuffs_aux::DecodeJsonCallbacks {
     pybind11::object jvalue;
     bool has_map_key;
     std::string map_key;
+    NumericArray numeric;
 
     bool IsList() { return pybind11::isinstance<pybind11::list>(jvalue); }
 
     bool IsDict() { return pybind11::isinstance<pybind11::dict>(jvalue); }
   };
 
-  explicit JsonDecoder(const JsonDecoderConfig& config)
-      : quirks_vector_(utils::ConvertQuirks(config.quirks)),
-        quirks_(wuffs_aux::DecodeJsonArgQuirks(quirks_vector_.data(),
-                                               quirks_vector_.size())),
-        json_pointer_(config.json_pointer) {}
+  explicit JsonObjectBuilder(uint32_t numeric_array_max_ndim = 0)
+      : numeric_array_max_ndim_(numeric_array_max_ndim) {}
 
   /* DecodeJsonCallbacks methods implementation */
 
@@ -154,6 +361,9 @@ class JsonDecoder : public wuffs_aux::DecodeJsonCallbacks {
       return "";
     }
     Entry& top = stack_.back();
+    if (top.numeric.enabled) {
+      DemoteNumericArray(top);
+    }
     if (top.IsList()) {
       top.jvalue.cast<pybind11::list>().append(std::move(jvalue));
       return "";
@@ -184,10 +394,22 @@ class JsonDecoder : public wuffs_aux::DecodeJsonCallbacks {
   }
 
   std::string AppendI64(int64_t val) override {
+    Number number;
+    number.is_f64 = false;
+    number.i64 = val;
+    if (AppendNumber(number)) {
+      return "";
+    }
     return Append(pybind11::int_(val));
   }
 
   std::string AppendF64(double val) override {
+    Number number;
+    number.is_f64 = true;
+    number.f64 = val;
+    if (AppendNumber(number)) {
+      return "";
+    }
     return Append(pybind11::float_(val));
   }
 
@@ -198,6 +420,10 @@ class JsonDecoder : public wuffs_aux::DecodeJsonCallbacks {
   std::string Push(uint32_t flags) override {
     if (flags & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_LIST) {
       stack_.emplace_back(pybind11::list());
+      if (numeric_array_max_ndim_ > 0) {
+        stack_.back().numeric.enabled = true;
+        stack_.back().numeric.shape = {0};
+      }
       return "";
     } else if (flags & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_DICT) {
       stack_.emplace_back(pybind11::dict());
@@ -210,54 +436,2146 @@ class JsonDecoder : public wuffs_aux::DecodeJsonCallbacks {
     if (stack_.empty()) {
       return "main: internal error: bad pop";
     }
-    pybind11::object jvalue = std::move(stack_.back().jvalue);
+    Entry entry = std::move(stack_.back());
     stack_.pop_back();
-    return Append(std::move(jvalue));
+    if (entry.numeric.enabled && (entry.numeric.shape[0] > 0)) {
+      if (AppendNumericArray(entry.numeric)) {
+        return "";
+      }
+      return Append(MakeNdarray(entry.numeric.values.data(),
+                                entry.numeric.values.size(),
+                                entry.numeric.shape));
+    }
+    return Append(std::move(entry.jvalue));
   }
 
   /* End of DecodeJsonCallbacks methods implementation */
 
-  JsonDecodingResult Decode(const uint8_t* data, size_t size) {
-    wuffs_aux::sync_io::MemoryInput input(data, size);
-    return DecodeInternal(input);
+  // Returns the built value (or a null object if there is not exactly one
+  // top-level value) and resets the builder.
+  pybind11::object Take() {
+    pybind11::object jvalue;
+    if (stack_.size() == 1) {
+      jvalue = std::move(stack_[0].jvalue);
+    }
+    stack_.clear();
+    return jvalue;
   }
 
-  JsonDecodingResult Decode(const std::string& path_to_file) {
-    FILE* f = fopen(path_to_file.c_str(), "rb");
-    if (!f) {
-      JsonDecodingResult result;
-      result.error_message = JsonDecoderError::FailedToOpenFile;
-      result.parsed = pybind11::none();
-      return result;
+ private:
+  // Buffers a number if the innermost array is still a numeric one.
+  bool AppendNumber(const Number& number) {
+    if (stack_.empty()) {
+      return false;
     }
-    wuffs_aux::sync_io::FileInput input(f);
-    JsonDecodingResult result = DecodeInternal(input);
-    fclose(f);
-    return result;
+    NumericArray& array = stack_.back().numeric;
+    if (!array.enabled || (array.shape.size() != 1)) {
+      return false;
+    }
+    array.values.push_back(number);
+    array.shape[0]++;
+    return true;
   }
 
- private:
-  JsonDecodingResult DecodeInternal(wuffs_aux::sync_io::Input& input) {
-    wuffs_aux::DecodeJsonResult decode_json_result =
-        wuffs_aux::DecodeJson(*this, input, quirks_, json_pointer_);
-    JsonDecodingResult decoding_result;
-    decoding_result.error_message = std::move(decode_json_result.error_message);
-    decoding_result.cursor_position = decode_json_result.cursor_position;
-    if (stack_.size() != 1) {
-      decoding_result.error_message = JsonDecoderError::BadDepth;
+  // Adds a finished numeric array as a row of the enclosing numeric array, if
+  // it has the same shape as the other rows.
+  bool AppendNumericArray(const NumericArray& child) {
+    if (stack_.empty()) {
+      return false;
     }
-    decoding_result.parsed = decoding_result.error_message.empty()
-                                 ? std::move(stack_[0].jvalue)
-                                 : pybind11::none();
-    stack_.clear();
-    return decoding_result;
+    NumericArray& array = stack_.back().numeric;
+    if (!array.enabled || (child.shape.size() >= numeric_array_max_ndim_)) {
+      return false;
+    }
+    if (array.shape[0] == 0) {
+      array.shape.insert(array.shape.end(), child.shape.begin(),
+                         child.shape.end());
+    } else if ((array.shape.size() != child.shape.size() + 1) ||
+               !std::equal(child.shape.begin(), child.shape.end(),
+                           array.shape.begin() + 1)) {
+      return false;
+    }
+    array.shape[0]++;
+    array.values.insert(array.values.end(), child.values.begin(),
+                        child.values.end());
+    return true;
+  }
+
+  // Falls back to a list for an array which turned out not to be a numeric
+  // one. The rows of a multidimensional array become NumPy arrays themselves.
+  static void DemoteNumericArray(Entry& entry) {
+    NumericArray& array = entry.numeric;
+    array.enabled = false;
+    pybind11::list jlist = entry.jvalue.cast<pybind11::list>();
+    if (array.shape.size() == 1) {
+      for (const Number& number : array.values) {
+        if (number.is_f64) {
+          jlist.append(pybind11::float_(number.f64));
+        } else {
+          jlist.append(pybind11::int_(number.i64));
+        }
+      }
+    } else if (!array.values.empty()) {
+      const std::vector<size_t> row_shape(array.shape.begin() + 1,
+                                          array.shape.end());
+      const size_t row_size = array.values.size() / array.shape[0];
+      for (size_t i = 0; i < array.shape[0]; i++) {
+        jlist.append(MakeNdarray(array.values.data() + i * row_size, row_size,
+                                 row_shape));
+      }
+    }
+    array.shape = {};
+    array.values = {};
+  }
+
+  // Creates a float64 NumPy array if any of the numbers is a floating point
+  // one, and an int64 array otherwise.
+  static pybind11::object MakeNdarray(const Number* values, size_t size,
+                                      const std::vector<size_t>& shape) {
+    const bool is_f64 = std::any_of(
+        values, values + size, [](const Number& n) { return n.is_f64; });
+    if (is_f64) {
+      pybind11::array_t<double> array(shape);
+      double* data = array.mutable_data();
+      for (size_t i = 0; i < size; i++) {
+        data[i] = values[i].is_f64 ? values[i].f64
+                                   : static_cast<double>(values[i].i64);
+      }
+      return std::move(array);
+    }
+    pybind11::array_t<int64_t> array(shape);
+    int64_t* data = array.mutable_data();
+    for (size_t i = 0; i < size; i++) {
+      data[i] = values[i].i64;
+    }
+    return std::move(array);
   }
 
  private:
-  std::vector<wuffs_aux::QuirkKeyValuePair> quirks_vector_;
-  wuffs_aux::DecodeJsonArgQuirks quirks_;
-  wuffs_aux::DecodeJsonArgJsonPointer json_pointer_;
+  uint32_t numeric_array_max_ndim_;
   std::vector<Entry> stack_;
 };
 
+// This class implements the wuffs_aux::DecodeJsonCallbacks interface for
+// extracting values at multiple JSON pointers in a single pass (see
+// JsonDecoderConfig::json_pointers). It tracks the path to the current value
+// and only forwards the subtrees matching any of the pointers to
+// JsonObjectBuilder instances, skipping everything else without creating
+// Python objects.
+class JsonPointersFilter : public wuffs_aux::DecodeJsonCallbacks {
+ public:
+  JsonPointersFilter(const std::vector<std::string>& json_pointers,
+                     bool allow_tilde_n_tilde_r_tilde_t,
+                     uint32_t numeric_array_max_ndim)
+      : numeric_array_max_ndim_(numeric_array_max_ndim),
+        results_(json_pointers.size()) {
+    for (const auto& json_pointer : json_pointers) {
+      pointers_.emplace_back();
+      if (!ParsePointer(json_pointer, allow_tilde_n_tilde_r_tilde_t,
+                        pointers_.back())) {
+        error_message_ = JsonDecoderError::BadJsonPointer;
+      }
+    }
+  }
+
+  // Non-empty if any of the pointers is invalid.
+  const std::string& error_message() const { return error_message_; }
+
+  // Returns a dict mapping the pointers to the extracted values (lists of the
+  // extracted values for pointers with wildcards) and resets the filter.
+  pybind11::dict Take() {
+    pybind11::dict extracted;
+    for (size_t i = 0; i < pointers_.size(); i++) {
+      if (pointers_[i].has_wildcard) {
+        extracted[pointers_[i].repr.c_str()] =
+            results_[i] ? results_[i] : pybind11::list();
+      } else if (results_[i]) {
+        extracted[pointers_[i].repr.c_str()] = results_[i];
+      }
+      results_[i] = pybind11::object();
+    }
+    path_.clear();
+    captures_.clear();
+    skip_depth_ = 0;
+    return extracted;
+  }
+
+  /* DecodeJsonCallbacks methods implementation */
+
+  std::string AppendNull() override {
+    return AppendScalar(
+        [](JsonObjectBuilder& builder) { return builder.AppendNull(); });
+  }
+
+  std::string AppendBool(bool val) override {
+    return AppendScalar(
+        [val](JsonObjectBuilder& builder) { return builder.AppendBool(val); });
+  }
+
+  std::string AppendI64(int64_t val) override {
+    return AppendScalar(
+        [val](JsonObjectBuilder& builder) { return builder.AppendI64(val); });
+  }
+
+  std::string AppendF64(double val) override {
+    return AppendScalar(
+        [val](JsonObjectBuilder& builder) { return builder.AppendF64(val); });
+  }
+
+  std::string AppendTextString(std::string&& val) override {
+    auto append = [&val](JsonObjectBuilder& builder) {
+      return builder.AppendTextString(std::string(val));
+    };
+    if ((skip_depth_ > 0) || path_.empty() || path_.back().is_list ||
+        path_.back().has_key) {
+      return AppendScalar(append);
+    }
+    // A map key
+    path_.back().has_key = true;
+    path_.back().key = val;
+    return Forward(append);
+  }
+
+  std::string Push(uint32_t flags) override {
+    if (skip_depth_ > 0) {
+      skip_depth_++;
+      return "";
+    }
+    std::vector<size_t> matched;
+    std::vector<size_t> live;
+    Match(matched, live);
+    if (captures_.empty() && matched.empty() && live.empty()) {
+      skip_depth_ = 1;
+      return "";
+    }
+    std::string error_message = Forward(
+        [flags](JsonObjectBuilder& builder) { return builder.Push(flags); });
+    if (!error_message.empty()) {
+      return error_message;
+    } else if (!matched.empty()) {
+      captures_.emplace_back(numeric_array_max_ndim_, path_.size(),
+                             std::move(matched));
+      error_message = captures_.back().builder.Push(flags);
+    }
+    path_.emplace_back(
+        (flags & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_LIST) != 0,
+        std::move(live));
+    return error_message;
+  }
+
+  std::string Pop(uint32_t flags) override {
+    if (skip_depth_ > 0) {
+      if (--skip_depth_ == 0) {
+        Advance();
+      }
+      return "";
+    }
+    if (path_.empty()) {
+      return "main: internal error: bad pop";
+    }
+    path_.pop_back();
+    std::string error_message = Forward(
+        [flags](JsonObjectBuilder& builder) { return builder.Pop(flags); });
+    if (!captures_.empty() && (captures_.back().depth == path_.size())) {
+      Record(captures_.back().pointers, captures_.back().builder.Take());
+      captures_.pop_back();
+    }
+    Advance();
+    return error_message;
+  }
+
+  /* End of DecodeJsonCallbacks methods implementation */
+
+ private:
+  static constexpr uint64_t kNoIndex = UINT64_MAX;
+
+  struct ReferenceToken {
+    std::string key;
+    // The array index the token stands for, if any
+    uint64_t index = kNoIndex;
+    bool wildcard = false;
+  };
+
+  struct Pointer {
+    std::string repr;
+    std::vector<ReferenceToken> tokens;
+    bool has_wildcard = false;
+  };
+
+  struct Frame {
+    Frame(bool is_list, std::vector<size_t>&& live)
+        : is_list(is_list), live(std::move(live)) {}
+
+    bool is_list;
+    // Indices of the pointers which may match values inside the container
+    std::vector<size_t> live;
+    // The position of the current value inside the container
+    uint64_t index = 0;
+    bool has_key = false;
+    std::string key;
+  };
+
+  struct Capture {
+    Capture(uint32_t numeric_array_max_ndim, size_t depth,
+            std::vector<size_t>&& pointers)
+        : builder(numeric_array_max_ndim),
+          depth(depth),
+          pointers(std::move(pointers)) {}
+
+    JsonObjectBuilder builder;
+    size_t depth;
+    std::vector<size_t> pointers;
+  };
+
+  static bool ParsePointer(const std::string& repr,
+                           bool allow_tilde_n_tilde_r_tilde_t,
+                           Pointer& pointer) {
+    pointer.repr = repr;
+    if (repr.empty()) {
+      return true;
+    } else if (repr[0] != '/') {
+      return false;
+    }
+    size_t i = 1;
+    while (true) {
+      pointer.tokens.emplace_back();
+      ReferenceToken& token = pointer.tokens.back();
+      for (; (i < repr.size()) && (repr[i] != '/'); i++) {
+        if (repr[i] != '~') {
+          token.key.push_back(repr[i]);
+          continue;
+        } else if (++i == repr.size()) {
+          return false;
+        }
+        const char c = repr[i];
+        if ((c == '0') || (c == '1')) {
+          token.key.push_back((c == '0') ? '~' : '/');
+        } else if (allow_tilde_n_tilde_r_tilde_t &&
+                   ((c == 'n') || (c == 'r') || (c == 't'))) {
+          token.key.push_back((c == 'n') ? '\n' : (c == 'r') ? '\r' : '\t');
+        } else {
+          return false;
+        }
+      }
+      token.wildcard = (token.key == "*");
+      token.index = ParseIndex(token.key);
+      pointer.has_wildcard |= token.wildcard;
+      if (i == repr.size()) {
+        return true;
+      }
+      // Skip the '/' separator
+      i++;
+    }
+  }
+
+  static uint64_t ParseIndex(const std::string& key) {
+    if (key.empty() || (key.size() > 19) ||
+        ((key.size() > 1) && (key[0] == '0'))) {
+      return kNoIndex;
+    }
+    uint64_t index = 0;
+    for (const char c : key) {
+      if ((c < '0') || (c > '9')) {
+        return kNoIndex;
+      }
+      index = 10 * index + static_cast<uint64_t>(c - '0');
+    }
+    return index;
+  }
+
+  // Splits the pointers which may match the value about to be appended into
+  // the ones matching the value itself and the ones which may match its
+  // descendants.
+  void Match(std::vector<size_t>& matched, std::vector<size_t>& live) const {
+    const size_t depth = path_.size();
+    if (depth == 0) {
+      for (size_t i = 0; i < pointers_.size(); i++) {
+        (pointers_[i].tokens.empty() ? matched : live).push_back(i);
+      }
+      return;
+    }
+    const Frame& frame = path_.back();
+    for (const size_t i : frame.live) {
+      const ReferenceToken& token = pointers_[i].tokens[depth - 1];
+      const bool matches =
+          frame.is_list ? (token.wildcard || (token.index == frame.index))
+                        : (token.key == frame.key);
+      if (matches) {
+        (pointers_[i].tokens.size() == depth ? matched : live).push_back(i);
+      }
+    }
+  }
+
+  template <typename Func>
+  std::string Forward(const Func& append) {
+    for (auto& capture : captures_) {
+      std::string error_message = append(capture.builder);
+      if (!error_message.empty()) {
+        return error_message;
+      }
+    }
+    return "";
+  }
+
+  template <typename Func>
+  std::string AppendScalar(const Func& append) {
+    if (skip_depth_ > 0) {
+      return "";
+    }
+    std::vector<size_t> matched;
+    std::vector<size_t> live;
+    Match(matched, live);
+    std::string error_message = Forward(append);
+    if (error_message.empty() && !matched.empty()) {
+      JsonObjectBuilder builder(numeric_array_max_ndim_);
+      error_message = append(builder);
+      Record(matched, builder.Take());
+    }
+    Advance();
+    return error_message;
+  }
+
+  void Record(const std::vector<size_t>& pointers,
+              const pybind11::object& jvalue) {
+    for (const size_t i : pointers) {
+      if (!pointers_[i].has_wildcard) {
+        results_[i] = jvalue;
+        continue;
+      } else if (!results_[i]) {
+        results_[i] = pybind11::list();
+      }
+      results_[i].cast<pybind11::list>().append(jvalue);
+    }
+  }
+
+  // Moves on to the next value in the current container.
+  void Advance() {
+    if (path_.empty()) {
+      return;
+    }
+    Frame& frame = path_.back();
+    frame.index++;
+    frame.has_key = false;
+  }
+
+  uint32_t numeric_array_max_ndim_;
+  std::vector<Pointer> pointers_;
+  std::vector<pybind11::object> results_;
+  std::string error_message_;
+  std::vector<Frame> path_;
+  std::vector<Capture> captures_;
+  // Nesting depth inside a skipped container
+  size_t skip_depth_ = 0;
+};
+
+// This class implements the wuffs_aux::DecodeJsonCallbacks interface for
+// decoding an array of JSON objects (records) into columns, one per field (see
+// JsonDecoder::DecodeColumnar). Scalar values are stored in typed native
+// buffers which are handed over to NumPy arrays without copying, so no Python
+// object is created per record. Nested values and columns of mixed types fall
+// back to NumPy object arrays.
+class JsonColumnarBuilder : public wuffs_aux::DecodeJsonCallbacks {
+ public:
+  // If the schema is not empty, it fixes the columns and their types, and the
+  // fields missing from it are skipped. Otherwise, the columns are created in
+  // the order of first appearance and their types are inferred.
+  JsonColumnarBuilder(const JsonColumnarSchema& schema,
+                      uint32_t numeric_array_max_ndim)
+      : has_schema_(!schema.empty()), nested_(numeric_array_max_ndim) {
+    for (const auto& field : schema) {
+      if (column_indices_.count(field.first)) {
+        continue;
+      }
+      Column& column = AddColumn(field.first);
+      SetType(column, field.second);
+      column.fixed_type = true;
+    }
+  }
+
+  // Returns a dict mapping field names to column dicts and resets the
+  // builder. Each column dict holds the "type" (JsonColumnType), the "data"
+  // NumPy array (bool, int64, float64, uint8 UTF-8 bytes for strings or
+  // object) and the "mask" bool NumPy array marking nulls and missing fields.
+  // String columns also hold the "offsets" int64 NumPy array of size rows + 1,
+  // the i-th string being data[offsets[i]:offsets[i + 1]].
+  pybind11::dict Take() {
+    pybind11::dict jcolumns;
+    for (Column& column : columns_) {
+      if (!column.has_type) {
+        SetType(column, JsonColumnType::OBJECT);
+      }
+      pybind11::dict jcolumn;
+      jcolumn["type"] = pybind11::cast(column.type);
+      switch (column.type) {
+        case JsonColumnType::BOOL:
+          jcolumn["data"] =
+              MakeNdarray(std::move(column.bools), pybind11::dtype("?"));
+          break;
+        case JsonColumnType::INT64:
+          jcolumn["data"] = MakeNdarray(std::move(column.i64s),
+                                        pybind11::dtype::of<int64_t>());
+          break;
+        case JsonColumnType::FLOAT64:
+          jcolumn["data"] = MakeNdarray(std::move(column.f64s),
+                                        pybind11::dtype::of<double>());
+          break;
+        case JsonColumnType::STRING:
+          jcolumn["data"] = MakeNdarray(std::move(column.chars),
+                                        pybind11::dtype::of<uint8_t>());
+          jcolumn["offsets"] = MakeNdarray(std::move(column.offsets),
+                                           pybind11::dtype::of<int64_t>());
+          break;
+        case JsonColumnType::OBJECT: {
+          pybind11::array jobjects(pybind11::dtype("O"),
+                                   {column.objects.size()});
+          PyObject** slots = static_cast<PyObject**>(jobjects.mutable_data());
+          for (size_t i = 0; i < column.objects.size(); i++) {
+            Py_XDECREF(slots[i]);
+            slots[i] = column.objects[i].release().ptr();
+          }
+          jcolumn["data"] = std::move(jobjects);
+          break;
+        }
+      }
+      jcolumn["mask"] =
+          MakeNdarray(std::move(column.mask), pybind11::dtype("?"));
+      jcolumns[column.name.c_str()] = std::move(jcolumn);
+    }
+    columns_.clear();
+    column_indices_.clear();
+    nested_.Take();
+    depth_ = 0;
+    rows_ = 0;
+    has_key_ = false;
+    column_index_ = kNoColumn;
+    return jcolumns;
+  }
+
+  /* DecodeJsonCallbacks methods implementation */
+
+  std::string AppendNull() override {
+    if (depth_ > kRecordDepth) {
+      return ForwardToNested(
+          [](JsonObjectBuilder& builder) { return builder.AppendNull(); });
+    }
+    return AppendValue([this](Column& column) {
+      column.mask.push_back(1);
+      PushDefault(column);
+      return true;
+    });
+  }
+
+  std::string AppendBool(bool val) override {
+    if (depth_ > kRecordDepth) {
+      return ForwardToNested([val](JsonObjectBuilder& builder) {
+        return builder.AppendBool(val);
+      });
+    }
+    return AppendValue([this, val](Column& column) {
+      if (!Accept(column, JsonColumnType::BOOL)) {
+        return false;
+      } else if (column.type == JsonColumnType::BOOL) {
+        column.bools.push_back(val ? 1 : 0);
+      } else {
+        column.objects.push_back(pybind11::bool_(val));
+      }
+      column.mask.push_back(0);
+      return true;
+    });
+  }
+
+  std::string AppendI64(int64_t val) override {
+    if (depth_ > kRecordDepth) {
+      return ForwardToNested(
+          [val](JsonObjectBuilder& builder) { return builder.AppendI64(val); });
+    }
+    return AppendValue([this, val](Column& column) {
+      if (!Accept(column, JsonColumnType::INT64)) {
+        return false;
+      } else if (column.type == JsonColumnType::INT64) {
+        column.i64s.push_back(val);
+      } else if (column.type == JsonColumnType::FLOAT64) {
+        column.f64s.push_back(static_cast<double>(val));
+      } else {
+        column.objects.push_back(pybind11::int_(val));
+      }
+      column.mask.push_back(0);
+      return true;
+    });
+  }
+
+  std::string AppendF64(double val) override {
+    if (depth_ > kRecordDepth) {
+      return ForwardToNested(
+          [val](JsonObjectBuilder& builder) { return builder.AppendF64(val); });
+    }
+    return AppendValue([this, val](Column& column) {
+      if (!Accept(column, JsonColumnType::FLOAT64)) {
+        return false;
+      } else if (column.type == JsonColumnType::FLOAT64) {
+        column.f64s.push_back(val);
+      } else {
+        column.objects.push_back(pybind11::float_(val));
+      }
+      column.mask.push_back(0);
+      return true;
+    });
+  }
+
+  std::string AppendTextString(std::string&& val) override {
+    if (depth_ > kRecordDepth) {
+      return ForwardToNested([&val](JsonObjectBuilder& builder) {
+        return builder.AppendTextString(std::move(val));
+      });
+    } else if ((depth_ == kRecordDepth) && !has_key_) {
+      return SetKey(std::move(val));
+    }
+    return AppendValue([this, &val](Column& column) {
+      if (!Accept(column, JsonColumnType::STRING)) {
+        return false;
+      } else if (column.type == JsonColumnType::STRING) {
+        column.chars.insert(column.chars.end(), val.begin(), val.end());
+        column.offsets.push_back(static_cast<int64_t>(column.chars.size()));
+      } else {
+        column.objects.push_back(pybind11::str(val));
+      }
+      column.mask.push_back(0);
+      return true;
+    });
+  }
+
+  std::string Push(uint32_t flags) override {
+    if (depth_ == 0) {
+      if (!(flags & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_LIST)) {
+        return JsonDecoderError::NonRecordArray;
+      }
+    } else if (depth_ == kRecordDepth - 1) {
+      if (!(flags & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_DICT)) {
+        return JsonDecoderError::NonRecordArray;
+      }
+      has_key_ = false;
+    } else if (depth_ == kRecordDepth) {
+      // A nested value, which is built as a Python object unless its field is
+      // skipped
+      if (column_index_ != kNoColumn) {
+        Column& column = columns_[column_index_];
+        if (!Accept(column, JsonColumnType::OBJECT)) {
+          return JsonDecoderError::BadColumnType + column.name;
+        }
+      }
+    }
+    depth_++;
+    if (depth_ > kRecordDepth) {
+      return ForwardToNested(
+          [flags](JsonObjectBuilder& builder) { return builder.Push(flags); });
+    }
+    return "";
+  }
+
+  std::string Pop(uint32_t flags) override {
+    if (depth_ == 0) {
+      return "main: internal error: bad pop";
+    }
+    std::string error_message;
+    if (depth_ > kRecordDepth) {
+      error_message = ForwardToNested(
+          [flags](JsonObjectBuilder& builder) { return builder.Pop(flags); });
+    } else if (depth_ == kRecordDepth) {
+      EndRecord();
+    }
+    depth_--;
+    if (error_message.empty() && (depth_ == kRecordDepth)) {
+      // The nested value is complete
+      if (column_index_ != kNoColumn) {
+        Column& column = columns_[column_index_];
+        column.objects.push_back(nested_.Take());
+        column.mask.push_back(0);
+        column.size++;
+      }
+      has_key_ = false;
+    }
+    return error_message;
+  }
+
+  /* End of DecodeJsonCallbacks methods implementation */
+
+ private:
+  // Depth of the values inside the records
+  static constexpr size_t kRecordDepth = 2;
+  static constexpr size_t kNoColumn = static_cast<size_t>(-1);
+
+  struct Column {
+    std::string name;
+    bool has_type = false;
+    bool fixed_type = false;
+    JsonColumnType type = JsonColumnType::OBJECT;
+    // Number of values, nulls included
+    size_t size = 0;
+    // 1 for nulls and missing fields
+    std::vector<uint8_t> mask;
+    // Only the buffer matching the type is used
+    std::vector<uint8_t> bools;
+    std::vector<int64_t> i64s;
+    std::vector<double> f64s;
+    std::vector<uint8_t> chars;
+    std::vector<int64_t> offsets;
+    std::vector<pybind11::object> objects;
+  };
+
+  Column& AddColumn(const std::string& name) {
+    column_indices_[name] = columns_.size();
+    columns_.emplace_back();
+    columns_.back().name = name;
+    return columns_.back();
+  }
+
+  std::string SetKey(std::string&& key) {
+    has_key_ = true;
+    const auto it = column_indices_.find(key);
+    if (it != column_indices_.end()) {
+      column_index_ = it->second;
+      if (columns_[column_index_].size > rows_) {
+        return JsonDecoderError::DuplicateMapKey + key;
+      }
+    } else if (has_schema_) {
+      column_index_ = kNoColumn;
+    } else {
+      column_index_ = columns_.size();
+      Column& column = AddColumn(key);
+      // The field is missing from the previous records
+      column.mask.resize(rows_, 1);
+      column.size = rows_;
+    }
+    return "";
+  }
+
+  // Appends a scalar value to the current column. The store function returns
+  // false if the value doesn't match the column type.
+  template <typename Func>
+  std::string AppendValue(const Func& store) {
+    if ((depth_ != kRecordDepth) || !has_key_) {
+      return (depth_ == kRecordDepth) ? JsonDecoderError::NonStringMapKey
+                                      : JsonDecoderError::NonRecordArray;
+    }
+    has_key_ = false;
+    if (column_index_ == kNoColumn) {
+      return "";
+    }
+    Column& column = columns_[column_index_];
+    if (!store(column)) {
+      return JsonDecoderError::BadColumnType + column.name;
+    }
+    column.size++;
+    return "";
+  }
+
+  template <typename Func>
+  std::string ForwardToNested(const Func& append) {
+    if (column_index_ == kNoColumn) {
+      return "";
+    }
+    return append(nested_);
+  }
+
+  // Fills the fields missing from the record with nulls.
+  void EndRecord() {
+    rows_++;
+    for (Column& column : columns_) {
+      if (column.size < rows_) {
+        column.mask.push_back(1);
+        PushDefault(column);
+        column.size++;
+      }
+    }
+  }
+
+  // Makes the column able to store a value of the given type, converting it
+  // if needed. Returns false if the column type is fixed by the schema and
+  // doesn't match.
+  bool Accept(Column& column, JsonColumnType type) {
+    if (!column.has_type) {
+      SetType(column, type);
+      return true;
+    } else if ((column.type == type) ||
+               (column.type == JsonColumnType::OBJECT) ||
+               ((column.type == JsonColumnType::FLOAT64) &&
+                (type == JsonColumnType::INT64))) {
+      return true;
+    } else if (column.fixed_type) {
+      return false;
+    } else if ((column.type == JsonColumnType::INT64) &&
+               (type == JsonColumnType::FLOAT64)) {
+      column.f64s.reserve(column.i64s.size());
+      for (size_t i = 0; i < column.i64s.size(); i++) {
+        column.f64s.push_back(column.mask[i]
+                                  ? std::numeric_limits<double>::quiet_NaN()
+                                  : static_cast<double>(column.i64s[i]));
+      }
+      column.i64s = {};
+      column.type = JsonColumnType::FLOAT64;
+      return true;
+    }
+    ConvertToObject(column);
+    return true;
+  }
+
+  // Sets the type of a column holding only nulls so far.
+  static void SetType(Column& column, JsonColumnType type) {
+    column.type = type;
+    column.has_type = true;
+    if (type == JsonColumnType::STRING) {
+      column.offsets.push_back(0);
+    }
+    for (size_t i = 0; i < column.size; i++) {
+      PushDefault(column);
+    }
+  }
+
+  static void PushDefault(Column& column) {
+    if (!column.has_type) {
+      return;
+    }
+    switch (column.type) {
+      case JsonColumnType::BOOL:
+        column.bools.push_back(0);
+        break;
+      case JsonColumnType::INT64:
+        column.i64s.push_back(0);
+        break;
+      case JsonColumnType::FLOAT64:
+        column.f64s.push_back(std::numeric_limits<double>::quiet_NaN());
+        break;
+      case JsonColumnType::STRING:
+        column.offsets.push_back(static_cast<int64_t>(column.chars.size()));
+        break;
+      case JsonColumnType::OBJECT:
+        column.objects.push_back(pybind11::none());
+        break;
+    }
+  }
+
+  static void ConvertToObject(Column& column) {
+    std::vector<pybind11::object> objects;
+    objects.reserve(column.size);
+    for (size_t i = 0; i < column.size; i++) {
+      if (column.mask[i]) {
+        objects.push_back(pybind11::none());
+        continue;
+      }
+      switch (column.type) {
+        case JsonColumnType::BOOL:
+          objects.push_back(pybind11::bool_(column.bools[i] != 0));
+          break;
+        case JsonColumnType::INT64:
+          objects.push_back(pybind11::int_(column.i64s[i]));
+          break;
+        case JsonColumnType::FLOAT64:
+          objects.push_back(pybind11::float_(column.f64s[i]));
+          break;
+        case JsonColumnType::STRING:
+          objects.push_back(pybind11::str(
+              reinterpret_cast<const char*>(column.chars.data()) +
+                  column.offsets[i],
+              column.offsets[i + 1] - column.offsets[i]));
+          break;
+        case JsonColumnType::OBJECT:
+          objects.push_back(std::move(column.objects[i]));
+          break;
+      }
+    }
+    column.bools = {};
+    column.i64s = {};
+    column.f64s = {};
+    column.chars = {};
+    column.offsets = {};
+    column.objects = std::move(objects);
+    column.type = JsonColumnType::OBJECT;
+  }
+
+  // Hands the buffer over to a 1D NumPy array without copying.
+  template <typename T>
+  static pybind11::array MakeNdarray(std::vector<T>&& values,
+                                     const pybind11::dtype& dtype) {
+    auto* buffer = new std::vector<T>(std::move(values));
+    pybind11::capsule owner(buffer, [](void* ptr) {
+      delete static_cast<std::vector<T>*>(ptr);
+    });
+    return pybind11::array(dtype, {buffer->size()}, {sizeof(T)},
+                           buffer->data(), owner);
+  }
+
+  bool has_schema_;
+  JsonObjectBuilder nested_;
+  std::vector<Column> columns_;
+  std::unordered_map<std::string, size_t> column_indices_;
+  // Nesting depth of the current value: 1 for the records, 2 for their values
+  size_t depth_ = 0;
+  size_t rows_ = 0;
+  bool has_key_ = false;
+  size_t column_index_ = kNoColumn;
+};
+
+// This class implements the wuffs_aux::DecodeJsonCallbacks interface for
+// checking a JSON document without building it: the Wuffs tokenizer checks the
+// syntax and UTF-8, and only duplicate map keys are checked here. It doesn't
+// touch Python objects, so it runs with the GIL released.
+class JsonValidator : public wuffs_aux::DecodeJsonCallbacks {
+ public:
+  // Whether the top-level value was complete, since the decoding doesn't
+  // always report it as an error otherwise.
+  bool has_value() const { return has_value_; }
+
+  /* DecodeJsonCallbacks methods implementation */
+
+  std::string AppendNull() override { return Append(); }
+
+  std::string AppendBool(bool) override { return Append(); }
+
+  std::string AppendI64(int64_t) override { return Append(); }
+
+  std::string AppendF64(double) override { return Append(); }
+
+  std::string AppendTextString(std::string&& val) override {
+    if ((depth_ == 0) || !frames_[depth_ - 1].is_dict ||
+        frames_[depth_ - 1].has_key) {
+      return Append();
+    }
+    Frame& top = frames_[depth_ - 1];
+    top.has_key = true;
+    if (top.keys.count(val) != 0) {
+      return JsonDecoderError::DuplicateMapKey + val;
+    }
+    top.keys.insert(std::move(val));
+    return "";
+  }
+
+  std::string Push(uint32_t flags) override {
+    if (depth_ > 0) {
+      std::string error_message = Append();
+      if (!error_message.empty()) {
+        return error_message;
+      }
+    }
+    // Frames are reused, so that the key sets keep their allocated buckets
+    if (depth_ == frames_.size()) {
+      frames_.emplace_back();
+    }
+    Frame& frame = frames_[depth_++];
+    frame.is_dict = (flags & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_DICT) != 0;
+    frame.has_key = false;
+    frame.keys.clear();
+    return "";
+  }
+
+  std::string Pop(uint32_t) override {
+    if (depth_ == 0) {
+      return "main: internal error: bad pop";
+    }
+    depth_--;
+    has_value_ = (depth_ == 0);
+    return "";
+  }
+
+  /* End of DecodeJsonCallbacks methods implementation */
+
+ private:
+  struct Frame {
+    bool is_dict = false;
+    bool has_key = false;
+    std::unordered_set<std::string> keys;
+  };
+
+  std::string Append() {
+    if (depth_ == 0) {
+      has_value_ = true;
+      return "";
+    }
+    Frame& top = frames_[depth_ - 1];
+    if (top.is_dict) {
+      if (!top.has_key) {
+        return JsonDecoderError::NonStringMapKey;
+      }
+      top.has_key = false;
+    }
+    return "";
+  }
+
+  std::vector<Frame> frames_;
+  size_t depth_ = 0;
+  bool has_value_ = false;
+};
+
+// Chunks of the top-level array elements or object members of a JSON
+// document, as found by SplitJsonTopLevel
+struct JsonTopLevelSplit {
+  // '[' or '{'
+  uint8_t open_char = 0;
+  // The position right after the top-level closing bracket, i.e. the cursor
+  // position of a successful decoding
+  size_t end = 0;
+  // Chunks of comma-separated elements (members) without the enclosing
+  // brackets, in order
+  std::vector<std::pair<const uint8_t*, size_t>> chunks;
+};
+
+// Scans the structure of a JSON document whose top-level value is an array or
+// an object and splits its contents at the top-level commas into chunks of at
+// least chunk_size bytes. Only brackets, commas and string boundaries are
+// looked at (strings are skipped with memchr), the actual validation is left
+// to the decoder. Returns false if the document doesn't look like a
+// well-formed non-empty array or object.
+inline bool SplitJsonTopLevel(const uint8_t* data, size_t size,
+                              size_t chunk_size, JsonTopLevelSplit& split) {
+  const auto is_space = [](uint8_t c) {
+    return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t');
+  };
+  size_t i = 0;
+  while ((i < size) && is_space(data[i])) {
+    i++;
+  }
+  if ((i == size) || ((data[i] != '[') && (data[i] != '{'))) {
+    return false;
+  }
+  split.open_char = data[i];
+  const uint8_t close_char = (split.open_char == '[') ? ']' : '}';
+  split.chunks.clear();
+  size_t chunk_start = ++i;
+  size_t depth = 1;
+  bool has_value = false;
+  while (i < size) {
+    const uint8_t c = data[i];
+    if (c == '"') {
+      // Skips to the closing quote, i.e. the first one preceded by an even
+      // number of backslashes
+      size_t j = i + 1;
+      while (true) {
+        const void* quote = memchr(data + j, '"', size - j);
+        if (!quote) {
+          return false;
+        }
+        j = static_cast<const uint8_t*>(quote) - data;
+        size_t num_backslashes = 0;
+        while (data[j - 1 - num_backslashes] == '\\') {
+          num_backslashes++;
+        }
+        if (num_backslashes % 2 == 0) {
+          break;
+        }
+        j++;
+      }
+      i = j + 1;
+      has_value = true;
+      continue;
+    }
+    if ((c == '[') || (c == '{')) {
+      depth++;
+    } else if ((c == ']') || (c == '}')) {
+      if (--depth == 0) {
+        if ((c != close_char) || !has_value) {
+          return false;
+        }
+        split.chunks.emplace_back(data + chunk_start, i - chunk_start);
+        split.end = i + 1;
+        return true;
+      }
+    } else if ((c == ',') && (depth == 1)) {
+      if (!has_value) {
+        return false;
+      }
+      has_value = false;
+      if (i - chunk_start >= chunk_size) {
+        split.chunks.emplace_back(data + chunk_start, i - chunk_start);
+        chunk_start = i + 1;
+      }
+      i++;
+      continue;
+    } else if (is_space(c)) {
+      i++;
+      continue;
+    }
+    has_value = true;
+    i++;
+  }
+  return false;
+}
+
+// This class implements wuffs_aux::sync_io::Input for a chunk of a JSON
+// document enclosed in the given brackets, so that a chunk of array elements
+// (object members) is decoded as an array (object) of its own.
+class JsonBracketedInput : public wuffs_aux::sync_io::Input {
+ public:
+  JsonBracketedInput(uint8_t open_char, const uint8_t* data, size_t size,
+                     uint8_t close_char)
+      : open_char_(open_char),
+        close_char_(close_char),
+        data_(data),
+        size_(size) {}
+
+  std::string CopyIn(wuffs_aux::IOBuffer* dst) override {
+    if (!dst) {
+      return "wuffs_aux_wrap::JsonBracketedInput: nullptr IOBuffer";
+    } else if (dst->meta.closed) {
+      return "wuffs_aux_wrap::JsonBracketedInput: end of file";
+    }
+    dst->compact();
+    // The position counts the opening bracket, the data and the closing one
+    while ((dst->writer_length() > 0) && (position_ < size_ + 2)) {
+      if (position_ == 0) {
+        *dst->writer_pointer() = open_char_;
+        dst->meta.wi++;
+        position_++;
+      } else if (position_ <= size_) {
+        const size_t n =
+            std::min(dst->writer_length(), size_ - (position_ - 1));
+        memcpy(dst->writer_pointer(), data_ + position_ - 1, n);
+        dst->meta.wi += n;
+        position_ += n;
+      } else {
+        *dst->writer_pointer() = close_char_;
+        dst->meta.wi++;
+        position_++;
+      }
+    }
+    if (position_ == size_ + 2) {
+      dst->meta.closed = true;
+    }
+    return "";
+  }
+
+ private:
+  uint8_t open_char_;
+  uint8_t close_char_;
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_ = 0;
+};
+
+class JsonRecordReader;
+class JsonEventParser;
+
+class JsonDecoder {
+ public:
+  explicit JsonDecoder(const JsonDecoderConfig& config)
+      : quirks_vector_(utils::ConvertQuirks(config.quirks)),
+        quirks_(wuffs_aux::DecodeJsonArgQuirks(quirks_vector_.data(),
+                                               quirks_vector_.size())),
+        json_pointer_(config.json_pointer),
+        numeric_array_max_ndim_(config.numeric_array_max_ndim),
+        compression_(config.compression),
+        collect_stats_(config.collect_stats),
+        builder_(config.numeric_array_max_ndim) {
+    if (!config.json_pointers.empty()) {
+      const auto tilde_quirk = config.quirks.find(
+          JsonDecoderQuirks::JSON_POINTER_ALLOW_TILDE_N_TILDE_R_TILDE_T);
+      pointers_filter_.reset(new JsonPointersFilter(
+          config.json_pointers,
+          (tilde_quirk != config.quirks.end()) && (tilde_quirk->second != 0),
+          config.numeric_array_max_ndim));
+    }
+  }
+
+  JsonDecodingResult Decode(const uint8_t* data, size_t size) {
+    wuffs_aux::sync_io::MemoryInput input(data, size);
+    return DecodeInternal(input);
+  }
+
+  JsonDecodingResult Decode(const std::string& path_to_file) {
+    FILE* f = fopen(path_to_file.c_str(), "rb");
+    if (!f) {
+      JsonDecodingResult result;
+      result.error_message = JsonDecoderError::FailedToOpenFile;
+      result.parsed = pybind11::none();
+      return result;
+    }
+    wuffs_aux::sync_io::FileInput input(f);
+    JsonDecodingResult result = DecodeInternal(input);
+    fclose(f);
+    return result;
+  }
+
+  JsonDecodingResult Decode(PythonFileInput& input) {
+    return DecodeInternal(input);
+  }
+
+  // Checks a JSON document without building Python objects. The json_pointer
+  // and json_pointers options are not applied.
+  JsonValidationResult Validate(const uint8_t* data, size_t size) {
+    pybind11::gil_scoped_release release_gil;
+    wuffs_aux::sync_io::MemoryInput input(data, size);
+    return ValidateInternal(input);
+  }
+
+  JsonValidationResult Validate(const std::string& path_to_file) {
+    pybind11::gil_scoped_release release_gil;
+    FILE* f = fopen(path_to_file.c_str(), "rb");
+    if (!f) {
+      JsonValidationResult result;
+      result.error_message = JsonDecoderError::FailedToOpenFile;
+      return result;
+    }
+    wuffs_aux::sync_io::FileInput input(f);
+    JsonValidationResult result = ValidateInternal(input);
+    fclose(f);
+    return result;
+  }
+
+  JsonValidationResult Validate(PythonFileInput& input) {
+    pybind11::gil_scoped_release release_gil;
+    return ValidateInternal(input);
+  }
+
+  // Decodes an array of JSON objects into columns (see JsonColumnarBuilder).
+  // The json_pointers option is not applied.
+  JsonDecodingResult DecodeColumnar(const uint8_t* data, size_t size,
+                                    const JsonColumnarSchema& schema) {
+    wuffs_aux::sync_io::MemoryInput input(data, size);
+    return DecodeColumnarInternal(input, schema);
+  }
+
+  JsonDecodingResult DecodeColumnar(const std::string& path_to_file,
+                                    const JsonColumnarSchema& schema) {
+    FILE* f = fopen(path_to_file.c_str(), "rb");
+    if (!f) {
+      JsonDecodingResult result;
+      result.error_message = JsonDecoderError::FailedToOpenFile;
+      result.parsed = pybind11::none();
+      return result;
+    }
+    wuffs_aux::sync_io::FileInput input(f);
+    JsonDecodingResult result = DecodeColumnarInternal(input, schema);
+    fclose(f);
+    return result;
+  }
+
+  // Decodes multiple documents. The Wuffs tokenizing and number/string
+  // parsing run on up to num_threads native threads with the GIL released,
+  // then Python objects are created on the calling thread. Results preserve
+  // the input order.
+  std::vector<JsonDecodingResult> DecodeMany(
+      const std::vector<std::pair<const uint8_t*, size_t>>& buffers,
+      size_t num_threads) {
+    std::vector<JsonTape> tapes(buffers.size());
+    std::vector<Clock::duration> parse_durations(buffers.size());
+    {
+      pybind11::gil_scoped_release release_gil;
+      utils::ParallelFor(buffers.size(), num_threads, [&](size_t i) {
+        const Clock::time_point start = Clock::now();
+        wuffs_aux::sync_io::MemoryInput input(buffers[i].first,
+                                              buffers[i].second);
+        DecompressingInput decompressing_input(compression_, input);
+        tapes[i].Decode(decompressing_input.Get(), quirks_, json_pointer_);
+        parse_durations[i] = Clock::now() - start;
+      });
+    }
+    std::vector<JsonDecodingResult> results;
+    results.reserve(buffers.size());
+    for (size_t i = 0; i < buffers.size(); i++) {
+      const Clock::time_point start = Clock::now();
+      bool replay_failed = false;
+      results.push_back(DecodeTape(tapes[i], replay_failed));
+      // A callback error (e.g. a duplicate map key) stops the regular decoding
+      // at a different cursor position, so redo the decoding to report it
+      // exactly the same way. Other errors come from the tape as is.
+      if (replay_failed) {
+        results.back() = Decode(buffers[i].first, buffers[i].second);
+      } else {
+        // The parsing ran on a worker thread and the Python conversion on
+        // this one, so the phases are timed separately
+        const Clock::time_point end = Clock::now();
+        JsonDecodingResult& result = results.back();
+        Metrics::Record(kJsonMetricsName, result.cursor_position,
+                        SecondsBetween(start - parse_durations[i], end),
+                        JsonErrorMetricsKey(result.error_message));
+        if (collect_stats_) {
+          result.stats.input_bytes = result.cursor_position;
+          result.stats.AddPhase("parse", start - parse_durations[i], start);
+          result.stats.AddPhase("python_conversion", start, end);
+        }
+      }
+      tapes[i] = JsonTape();
+    }
+    return results;
+  }
+
+  // Decodes a single large document whose top-level value is an array or an
+  // object. The contents are split at the top-level commas (see
+  // SplitJsonTopLevel), the chunks are tokenized and parsed on up to
+  // num_threads native threads with the GIL released, then Python objects are
+  // created on the calling thread and stitched together in order. The
+  // document is decoded with Decode instead if the split doesn't apply
+  // (quirks, JSON pointers, numeric arrays, compression, a small document or
+  // a single thread) or any chunk fails, so that the results, including the
+  // error messages and the cursor positions, are exactly the same.
+  JsonDecodingResult DecodeParallel(const uint8_t* data, size_t size,
+                                    size_t num_threads) {
+    static constexpr size_t kMinChunkSize = 64 * 1024;
+    if (num_threads == 0) {
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if ((num_threads <= 1) || !quirks_vector_.empty() ||
+        !json_pointer_.repr.empty() || pointers_filter_ ||
+        (numeric_array_max_ndim_ != 0) ||
+        (compression_ != InputCompression::NONE)) {
+      return Decode(data, size);
+    }
+    const Clock::time_point start = Clock::now();
+    // A few chunks per thread, so that the uneven ones are balanced out
+    const size_t chunk_size = std::max(kMinChunkSize, size / (num_threads * 4));
+    JsonTopLevelSplit split;
+    std::vector<JsonTape> tapes;
+    {
+      pybind11::gil_scoped_release release_gil;
+      if (SplitJsonTopLevel(data, size, chunk_size, split) &&
+          (split.chunks.size() > 1)) {
+        tapes.resize(split.chunks.size());
+        const uint8_t close_char = (split.open_char == '[') ? ']' : '}';
+        utils::ParallelFor(tapes.size(), num_threads, [&](size_t i) {
+          JsonBracketedInput input(split.open_char, split.chunks[i].first,
+                                   split.chunks[i].second, close_char);
+          tapes[i].Decode(input, quirks_, json_pointer_);
+        });
+      }
+    }
+    if (tapes.empty()) {
+      return Decode(data, size);
+    }
+    const Clock::time_point conversion_start = Clock::now();
+    pybind11::object parsed = StitchTapes(split, tapes);
+    if (!parsed) {
+      return Decode(data, size);
+    }
+    const Clock::time_point end = Clock::now();
+    JsonDecodingResult result;
+    result.cursor_position = split.end;
+    result.parsed = std::move(parsed);
+    Metrics::Record(kJsonMetricsName, result.cursor_position,
+                    SecondsBetween(start, end),
+                    JsonErrorMetricsKey(result.error_message));
+    if (collect_stats_) {
+      result.stats.input_bytes = result.cursor_position;
+      result.stats.AddPhase("parse", start, conversion_start);
+      result.stats.AddPhase("python_conversion", conversion_start, end);
+    }
+    return result;
+  }
+
+ private:
+  friend class JsonRecordReader;
+  friend class JsonEventParser;
+
+  wuffs_aux::DecodeJsonCallbacks& callbacks() {
+    if (pointers_filter_) {
+      return *pointers_filter_;
+    }
+    return builder_;
+  }
+
+  // Records the metrics of a decode done in one go (the Wuffs tokenizing and
+  // the Python objects creation are interleaved) and, if enabled, its stats.
+  // The input size is the number of bytes consumed by the decoder.
+  void RecordDecode(JsonDecodingResult& result, Clock::time_point start) {
+    const Clock::time_point end = Clock::now();
+    Metrics::Record(kJsonMetricsName, result.cursor_position,
+                    SecondsBetween(start, end),
+                    JsonErrorMetricsKey(result.error_message));
+    if (collect_stats_) {
+      result.stats.input_bytes = result.cursor_position;
+      result.stats.AddPhase("decode", start, end);
+    }
+  }
+
+  JsonDecodingResult DecodeInternal(wuffs_aux::sync_io::Input& input) {
+    DecompressingInput decompressing_input(compression_, input);
+    return DecodeDecompressed(decompressing_input.Get());
+  }
+
+  // Decodes the input as is, i.e. ignoring the compression setting, e.g. for
+  // the records of JsonRecordsInput, which decompresses the whole stream.
+  JsonDecodingResult DecodeDecompressed(wuffs_aux::sync_io::Input& input) {
+    if (pointers_filter_ && !pointers_filter_->error_message().empty()) {
+      return MakeResult(std::string(pointers_filter_->error_message()), 0);
+    }
+    const Clock::time_point start = Clock::now();
+    wuffs_aux::DecodeJsonResult decode_json_result =
+        wuffs_aux::DecodeJson(callbacks(), input, quirks_, json_pointer_);
+    JsonDecodingResult decoding_result =
+        MakeResult(std::move(decode_json_result.error_message),
+                   decode_json_result.cursor_position);
+    RecordDecode(decoding_result, start);
+    return decoding_result;
+  }
+
+  JsonValidationResult ValidateInternal(wuffs_aux::sync_io::Input& input) {
+    const Clock::time_point start = Clock::now();
+    // A local validator, since the GIL doesn't serialize the calls
+    JsonValidator validator;
+    DecompressingInput decompressing_input(compression_, input);
+    wuffs_aux::DecodeJsonResult decode_json_result = wuffs_aux::DecodeJson(
+        validator, decompressing_input.Get(), quirks_,
+        wuffs_aux::DecodeJsonArgJsonPointer::DefaultValue());
+    JsonValidationResult validation_result;
+    validation_result.error_message =
+        std::move(decode_json_result.error_message);
+    validation_result.cursor_position = decode_json_result.cursor_position;
+    if (validation_result.error_message.empty() && !validator.has_value()) {
+      validation_result.error_message = JsonDecoderError::BadDepth;
+    }
+    Metrics::Record(kJsonMetricsName, validation_result.cursor_position,
+                    SecondsBetween(start, Clock::now()),
+                    JsonErrorMetricsKey(validation_result.error_message));
+    return validation_result;
+  }
+
+  JsonDecodingResult DecodeColumnarInternal(wuffs_aux::sync_io::Input& input,
+                                            const JsonColumnarSchema& schema) {
+    const Clock::time_point start = Clock::now();
+    JsonColumnarBuilder columnar_builder(schema, numeric_array_max_ndim_);
+    DecompressingInput decompressing_input(compression_, input);
+    wuffs_aux::DecodeJsonResult decode_json_result =
+        wuffs_aux::DecodeJson(columnar_builder, decompressing_input.Get(),
+                              quirks_, json_pointer_);
+    JsonDecodingResult decoding_result;
+    decoding_result.error_message = std::move(decode_json_result.error_message);
+    decoding_result.cursor_position = decode_json_result.cursor_position;
+    pybind11::object parsed = columnar_builder.Take();
+    decoding_result.parsed = decoding_result.error_message.empty()
+                                 ? std::move(parsed)
+                                 : pybind11::none();
+    RecordDecode(decoding_result, start);
+    return decoding_result;
+  }
+
+  // Builds the Python objects recorded on the tape. Sets replay_failed if the
+  // callbacks returned an error, i.e. if the result may differ from the one of
+  // DecodeDecompressed.
+  JsonDecodingResult DecodeTape(const JsonTape& tape, bool& replay_failed) {
+    replay_failed = false;
+    if (pointers_filter_ && !pointers_filter_->error_message().empty()) {
+      return MakeResult(std::string(pointers_filter_->error_message()), 0);
+    }
+    std::string error_message = tape.Replay(callbacks());
+    if (error_message.empty()) {
+      error_message = tape.error_message();
+    } else {
+      replay_failed = true;
+    }
+    return MakeResult(std::move(error_message), tape.cursor_position());
+  }
+
+  // Builds the chunks decoded by DecodeParallel and joins them into a single
+  // list or dict, releasing the tapes on the way. Returns a null object if a
+  // chunk failed or if the same key appears in different chunks.
+  pybind11::object StitchTapes(const JsonTopLevelSplit& split,
+                               std::vector<JsonTape>& tapes) {
+    const bool is_dict = (split.open_char == '{');
+    pybind11::object joined;
+    for (size_t i = 0; i < tapes.size(); i++) {
+      // The chunk decoding must have consumed the whole chunk, brackets
+      // included
+      if (!tapes[i].error_message().empty() ||
+          (tapes[i].cursor_position() != split.chunks[i].second + 2)) {
+        return pybind11::object();
+      }
+      const std::string error_message = tapes[i].Replay(builder_);
+      pybind11::object chunk = builder_.Take();
+      tapes[i] = JsonTape();
+      if (!error_message.empty() || !chunk) {
+        return pybind11::object();
+      }
+      if (!joined) {
+        joined = std::move(chunk);
+      } else if (is_dict) {
+        pybind11::dict dict = joined.cast<pybind11::dict>();
+        const size_t expected_size =
+            dict.size() + chunk.cast<pybind11::dict>().size();
+        dict.attr("update")(chunk);
+        if (dict.size() != expected_size) {
+          return pybind11::object();
+        }
+      } else {
+        joined.attr("extend")(chunk);
+      }
+    }
+    return joined;
+  }
+
+  JsonDecodingResult MakeResult(std::string&& error_message,
+                                uint64_t cursor_position) {
+    JsonDecodingResult decoding_result;
+    decoding_result.error_message = std::move(error_message);
+    decoding_result.cursor_position = cursor_position;
+    pybind11::object parsed;
+    if (pointers_filter_) {
+      parsed = pointers_filter_->Take();
+    } else {
+      parsed = builder_.Take();
+      if (!parsed) {
+        decoding_result.error_message = JsonDecoderError::BadDepth;
+      }
+    }
+    decoding_result.parsed = decoding_result.error_message.empty()
+                                 ? std::move(parsed)
+                                 : pybind11::none();
+    return decoding_result;
+  }
+
+ private:
+  std::vector<wuffs_aux::QuirkKeyValuePair> quirks_vector_;
+  wuffs_aux::DecodeJsonArgQuirks quirks_;
+  wuffs_aux::DecodeJsonArgJsonPointer json_pointer_;
+  uint32_t numeric_array_max_ndim_;
+  InputCompression compression_;
+  bool collect_stats_;
+  JsonObjectBuilder builder_;
+  std::unique_ptr<JsonPointersFilter> pointers_filter_;
+};
+
+// This class implements wuffs_aux::sync_io::Input for a stream of JSON records
+// (JSON Lines / NDJSON or whitespace-separated concatenated JSON) read from
+// memory, a file or a Python file-like object. Unlike
+// wuffs_aux::sync_io::FileInput, it brings its own IO buffer, which outlives a
+// single wuffs_aux::DecodeJson call, so that the stream is decoded record by
+// record with bounded memory. Only the current line is exposed to the JSON
+// decoder (the IO buffer gets closed at each new line), so a malformed record
+// can't swallow the following ones. A compressed stream is decompressed as a
+// whole before being split into lines.
+class JsonRecordsInput : public wuffs_aux::sync_io::Input {
+ public:
+  static constexpr size_t kBufferSize = 64 * 1024;
+
+  JsonRecordsInput(const uint8_t* data, size_t size,
+                   InputCompression compression)
+      : file_(nullptr),
+        src_(data),
+        src_end_(data + size),
+        io_array_(new uint8_t[kBufferSize]),
+        io_buf_(wuffs_base__ptr_u8__writer(io_array_.get(), kBufferSize)) {
+    if (compression != InputCompression::NONE) {
+      src_ = src_end_ = nullptr;
+      file_array_.reset(new uint8_t[kBufferSize]);
+      source_.reset(new wuffs_aux::sync_io::MemoryInput(data, size));
+      InitDecompression(compression, *source_);
+    }
+  }
+
+  // Takes ownership of the given file.
+  JsonRecordsInput(FILE* f, InputCompression compression)
+      : file_(f),
+        file_array_(new uint8_t[kBufferSize]),
+        src_(nullptr),
+        src_end_(nullptr),
+        io_array_(new uint8_t[kBufferSize]),
+        io_buf_(wuffs_base__ptr_u8__writer(io_array_.get(), kBufferSize)) {
+    if (compression != InputCompression::NONE) {
+      source_.reset(new wuffs_aux::sync_io::FileInput(file_));
+      InitDecompression(compression, *source_);
+    }
+  }
+
+  JsonRecordsInput(std::unique_ptr<PythonFileInput> stream,
+                   InputCompression compression)
+      : file_(nullptr),
+        stream_(std::move(stream)),
+        file_array_(new uint8_t[kBufferSize]),
+        src_(nullptr),
+        src_end_(nullptr),
+        io_array_(new uint8_t[kBufferSize]),
+        io_buf_(wuffs_base__ptr_u8__writer(io_array_.get(), kBufferSize)) {
+    if (compression != InputCompression::NONE) {
+      InitDecompression(compression, *stream_);
+    }
+  }
+
+  ~JsonRecordsInput() override {
+    if (file_) {
+      fclose(file_);
+    }
+  }
+
+  JsonRecordsInput(const JsonRecordsInput& other) = delete;
+  JsonRecordsInput& operator=(const JsonRecordsInput& other) = delete;
+
+  wuffs_aux::IOBuffer* BringsItsOwnIOBuffer() override { return &io_buf_; }
+
+  std::string CopyIn(wuffs_aux::IOBuffer* dst) override {
+    if (!dst) {
+      return "wuffs_aux_wrap::JsonRecordsInput: nullptr IOBuffer";
+    } else if (dst->meta.closed) {
+      return "wuffs_aux_wrap::JsonRecordsInput: end of line";
+    }
+    if (!Fill()) {
+      dst->meta.closed = true;
+      std::string error_message = ReadErrorMessage();
+      if (!error_message.empty()) {
+        error_reported_ = true;
+      }
+      return error_message;
+    }
+    size_t n = std::min(static_cast<size_t>(src_end_ - src_),
+                        dst->writer_length());
+    const void* new_line = std::memchr(src_, '\n', n);
+    if (new_line) {
+      n = static_cast<size_t>(static_cast<const uint8_t*>(new_line) - src_) +
+          1;
+      dst->meta.closed = true;
+    }
+    std::memcpy(dst->writer_pointer(), src_, n);
+    dst->meta.wi += n;
+    src_ += n;
+    return "";
+  }
+
+  // Skips the whitespace preceding the next record and compacts the IO buffer
+  // (wuffs_aux::DecodeJson expects it to start at the buffer's read index 0).
+  // Returns false if there are no records left.
+  bool SkipToNextRecord() {
+    while (true) {
+      while ((io_buf_.meta.ri < io_buf_.meta.wi) &&
+             IsWhitespace(io_buf_.data.ptr[io_buf_.meta.ri])) {
+        io_buf_.meta.ri++;
+      }
+      io_buf_.compact();
+      if (io_buf_.meta.wi > 0) {
+        return true;
+      }
+      io_buf_.meta.closed = false;
+      if (!Fill()) {
+        return false;
+      }
+      CopyIn(&io_buf_);
+    }
+  }
+
+  // Returns the read or decompression error which ended the stream, unless it
+  // was already returned to the JSON decoder (i.e. it's the error of a
+  // record).
+  std::string UnreportedErrorMessage() const {
+    return error_reported_ ? "" : ReadErrorMessage();
+  }
+
+  // Discards the rest of the current line, e.g. after a malformed record.
+  void SkipLine() {
+    io_buf_.meta.ri = io_buf_.meta.wi;
+    io_buf_.compact();
+    while (!io_buf_.meta.closed && Fill()) {
+      size_t n = static_cast<size_t>(src_end_ - src_);
+      const void* new_line = std::memchr(src_, '\n', n);
+      if (new_line) {
+        n = static_cast<size_t>(static_cast<const uint8_t*>(new_line) - src_) +
+            1;
+        io_buf_.meta.closed = true;
+      }
+      src_ += n;
+      io_buf_.meta.pos += n;
+    }
+  }
+
+ private:
+  static bool IsWhitespace(uint8_t c) {
+    return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+  }
+
+  void InitDecompression(InputCompression compression,
+                         wuffs_aux::sync_io::Input& source) {
+    decompressing_input_.reset(new DecompressingInput(compression, source));
+    decompressed_buf_ =
+        wuffs_base__ptr_u8__writer(file_array_.get(), kBufferSize);
+  }
+
+  std::string ReadErrorMessage() const {
+    if (!decompression_error_message_.empty()) {
+      return decompression_error_message_;
+    } else if (stream_) {
+      return stream_->error_message();
+    }
+    return (file_ && ferror(file_))
+               ? "wuffs_aux_wrap::JsonRecordsInput: I/O error"
+               : "";
+  }
+
+  // Makes sure there is pending source data. Returns false on EOF.
+  bool Fill() {
+    if (src_ < src_end_) {
+      return true;
+    } else if (decompressing_input_) {
+      return FillDecompressed();
+    } else if (!file_ && !stream_) {
+      return false;
+    }
+    size_t n = stream_ ? stream_->Read(file_array_.get(), kBufferSize)
+                       : fread(file_array_.get(), 1, kBufferSize, file_);
+    src_ = file_array_.get();
+    src_end_ = src_ + n;
+    return n > 0;
+  }
+
+  // Fill for a compressed source, with one decompressor for the whole stream.
+  bool FillDecompressed() {
+    while (!decompressed_buf_.meta.closed &&
+           decompression_error_message_.empty()) {
+      // The previous chunk was consumed
+      decompressed_buf_.meta.ri = decompressed_buf_.meta.wi = 0;
+      decompression_error_message_ =
+          decompressing_input_->CopyIn(&decompressed_buf_);
+      if (decompressed_buf_.meta.wi > 0) {
+        src_ = file_array_.get();
+        src_end_ = src_ + decompressed_buf_.meta.wi;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  FILE* file_;
+  std::unique_ptr<PythonFileInput> stream_;
+  // The compressed source, if it's neither the file nor the stream
+  std::unique_ptr<wuffs_aux::sync_io::Input> source_;
+  std::unique_ptr<DecompressingInput> decompressing_input_;
+  wuffs_aux::IOBuffer decompressed_buf_;
+  std::string decompression_error_message_;
+  // Whether CopyIn returned the read or decompression error
+  bool error_reported_ = false;
+  std::unique_ptr<uint8_t[]> file_array_;
+  const uint8_t* src_;
+  const uint8_t* src_end_;
+  std::unique_ptr<uint8_t[]> io_array_;
+  wuffs_aux::IOBuffer io_buf_;
+};
+
+// This class decodes a stream of JSON records (see JsonRecordsInput) one by
+// one using the given JsonDecoder. Errors are reported per record: the reader
+// skips the rest of the line holding a malformed record and goes on.
+class JsonRecordReader {
+ public:
+  JsonRecordReader(JsonDecoder& decoder, const uint8_t* data, size_t size,
+                   size_t batch_size)
+      : decoder_(decoder),
+        input_(new JsonRecordsInput(data, size, decoder.compression_)),
+        batch_size_(batch_size) {}
+
+  JsonRecordReader(JsonDecoder& decoder, const std::string& path_to_file,
+                   size_t batch_size)
+      : decoder_(decoder), batch_size_(batch_size) {
+    FILE* f = fopen(path_to_file.c_str(), "rb");
+    if (f) {
+      input_.reset(new JsonRecordsInput(f, decoder.compression_));
+    } else {
+      pending_error_ = JsonDecoderError::FailedToOpenFile;
+    }
+  }
+
+  JsonRecordReader(JsonDecoder& decoder,
+                   std::unique_ptr<PythonFileInput> stream, size_t batch_size)
+      : decoder_(decoder),
+        input_(new JsonRecordsInput(std::move(stream), decoder.compression_)),
+        batch_size_(batch_size) {}
+
+  // Decodes the next record into the given result. Returns false if there are
+  // no records left.
+  bool Next(JsonDecodingResult& result) {
+    if (!pending_error_.empty()) {
+      result.error_message = std::move(pending_error_);
+      result.parsed = pybind11::none();
+      pending_error_.clear();
+      return true;
+    }
+    if (!input_) {
+      return false;
+    } else if (!input_->SkipToNextRecord()) {
+      // A read or decompression error between records ends the stream
+      result.error_message = input_->UnreportedErrorMessage();
+      result.parsed = pybind11::none();
+      input_.reset();
+      return !result.error_message.empty();
+    }
+    result = decoder_.DecodeDecompressed(*input_);
+    // With a JSON pointer, wuffs_aux::DecodeJson stops right after the
+    // pointed-to value, so the rest of the record has to be skipped as well.
+    if (!result.error_message.empty() || !decoder_.json_pointer_.repr.empty()) {
+      input_->SkipLine();
+    }
+    return true;
+  }
+
+  size_t batch_size() const { return batch_size_; }
+
+ private:
+  JsonDecoder& decoder_;
+  std::unique_ptr<JsonRecordsInput> input_;
+  std::string pending_error_;
+  size_t batch_size_;
+};
+
+// This class implements an ijson-style pull parser yielding
+// (prefix, event, value) tuples straight from the Wuffs JSON tokens, so that
+// the memory usage doesn't depend on the document size. The input is read in
+// fixed-size chunks, the token handling mirrors wuffs_aux::DecodeJson.
+class JsonEventParser {
+ public:
+  static constexpr size_t kBufferSize = 64 * 1024;
+
+  // An empty prefix filter matches all the events.
+  JsonEventParser(JsonDecoder& decoder, const uint8_t* data, size_t size,
+                  const std::string& prefix_filter)
+      : input_(new wuffs_aux::sync_io::MemoryInput(data, size)),
+        prefix_filter_(prefix_filter) {
+    Init(decoder);
+  }
+
+  JsonEventParser(JsonDecoder& decoder, const std::string& path_to_file,
+                  const std::string& prefix_filter)
+      : prefix_filter_(prefix_filter) {
+    file_ = fopen(path_to_file.c_str(), "rb");
+    if (!file_) {
+      error_message_ = JsonDecoderError::FailedToOpenFile;
+      done_ = true;
+      return;
+    }
+    input_.reset(new wuffs_aux::sync_io::FileInput(file_));
+    Init(decoder);
+  }
+
+  JsonEventParser(JsonDecoder& decoder, std::unique_ptr<PythonFileInput> input,
+                  const std::string& prefix_filter)
+      : input_(std::move(input)), prefix_filter_(prefix_filter) {
+    Init(decoder);
+  }
+
+  ~JsonEventParser() {
+    if (file_) {
+      fclose(file_);
+    }
+  }
+
+  // Neither copyable nor movable, since the buffers point to each other
+  JsonEventParser(const JsonEventParser& other) = delete;
+  JsonEventParser& operator=(const JsonEventParser& other) = delete;
+
+  // Returns the next (prefix, event, value) tuple matching the prefix filter,
+  // or a null object if the document is over or an error occurred.
+  pybind11::object Next() {
+    while (!done_) {
+      if (tok_buf_.meta.ri >= tok_buf_.meta.wi) {
+        if (!DecodeTokens()) {
+          done_ = true;
+        }
+        continue;
+      }
+      const wuffs_base__token token = tok_buf_.data.ptr[tok_buf_.meta.ri++];
+      const uint64_t token_len = token.length();
+      if ((io_buf_->meta.ri < cursor_index_) ||
+          ((io_buf_->meta.ri - cursor_index_) < token_len)) {
+        Fail("wuffs_aux_wrap::JsonEventParser: internal error: bad token "
+             "indexes");
+        break;
+      }
+      uint8_t* token_ptr = io_buf_->data.ptr + cursor_index_;
+      cursor_index_ += token_len;
+      pybind11::object event = HandleToken(token, token_ptr, token_len);
+      if (event) {
+        return event;
+      }
+    }
+    return pybind11::object();
+  }
+
+  const std::string& error_message() const { return error_message_; }
+
+  uint64_t cursor_position() const {
+    return io_buf_ ? io_buf_->meta.pos + cursor_index_ : 0;
+  }
+
+ private:
+  enum Event {
+    kStartMap,
+    kMapKey,
+    kEndMap,
+    kStartArray,
+    kEndArray,
+    kNull,
+    kBoolean,
+    kNumber,
+    kString,
+    kNumEvents
+  };
+
+  struct Frame {
+    bool is_map;
+    bool expects_key;
+    // Length of the container's own prefix
+    size_t prefix_length;
+  };
+
+  void Init(JsonDecoder& decoder) {
+    static const char* const kEventNames[kNumEvents] = {
+        "start_map", "map_key", "end_map", "start_array", "end_array",
+        "null",      "boolean", "number",  "string"};
+    for (const char* event_name : kEventNames) {
+      event_names_.emplace_back(event_name);
+    }
+    json_decoder_ = wuffs_json__decoder::alloc();
+    if (!json_decoder_) {
+      Fail("wuffs_aux_wrap::JsonEventParser: out of memory");
+      return;
+    }
+    for (const auto& quirk : decoder.quirks_vector_) {
+      const wuffs_base__status status =
+          json_decoder_->set_quirk(quirk.first, quirk.second);
+      if (!status.is_ok()) {
+        Fail(status.message());
+        return;
+      }
+    }
+    // One decompressor for the whole stream
+    decompressing_input_.reset(
+        new DecompressingInput(decoder.compression_, *input_));
+    source_ = &decompressing_input_->Get();
+    io_buf_ = source_->BringsItsOwnIOBuffer();
+    if (!io_buf_) {
+      io_array_.reset(new uint8_t[kBufferSize]);
+      fallback_io_buf_ =
+          wuffs_base__ptr_u8__writer(io_array_.get(), kBufferSize);
+      io_buf_ = &fallback_io_buf_;
+    }
+    tok_buf_ = wuffs_base__slice_token__writer(
+        wuffs_base__make_slice_token(tok_array_, kTokenBufferSize));
+    // The first DecodeTokens call only makes room in the empty token buffer
+    tok_status_.repr = wuffs_base__suspension__short_write;
+  }
+
+  // Refills the token buffer. Returns false if the tokens are over.
+  bool DecodeTokens() {
+    if (tok_status_.repr == nullptr) {
+      return false;
+    } else if (tok_status_.repr == wuffs_base__suspension__short_write) {
+      tok_buf_.compact();
+    } else if (tok_status_.repr == wuffs_base__suspension__short_read) {
+      if (io_buf_->meta.closed) {
+        Fail("wuffs_aux_wrap::JsonEventParser: internal error: io_buf is "
+             "closed");
+        return false;
+      }
+      io_buf_->compact();
+      if (io_buf_->meta.wi >= io_buf_->data.len) {
+        Fail("wuffs_aux_wrap::JsonEventParser: internal error: io_buf is "
+             "full");
+        return false;
+      }
+      cursor_index_ = io_buf_->meta.ri;
+      std::string error_message;
+      {
+        pybind11::gil_scoped_release release_gil;
+        error_message = source_->CopyIn(io_buf_);
+      }
+      if (!error_message.empty()) {
+        Fail(std::move(error_message));
+        return false;
+      }
+    } else {
+      Fail(tok_status_.message());
+      return false;
+    }
+    tok_status_ = json_decoder_->decode_tokens(&tok_buf_, io_buf_,
+                                               wuffs_base__empty_slice_u8());
+    return true;
+  }
+
+  // Returns the event tuple for the token, if any.
+  pybind11::object HandleToken(const wuffs_base__token& token,
+                               uint8_t* token_ptr, uint64_t token_len) {
+    const int64_t vbc = token.value_base_category();
+    const uint64_t vbd = token.value_base_detail();
+    switch (vbc) {
+      case WUFFS_BASE__TOKEN__VBC__FILLER:
+        return pybind11::object();
+
+      case WUFFS_BASE__TOKEN__VBC__STRUCTURE:
+        if (vbd & WUFFS_BASE__TOKEN__VBD__STRUCTURE__PUSH) {
+          return Push((vbd & WUFFS_BASE__TOKEN__VBD__STRUCTURE__TO_DICT) != 0);
+        }
+        return Pop();
+
+      case WUFFS_BASE__TOKEN__VBC__STRING:
+        if (vbd & WUFFS_BASE__TOKEN__VBD__STRING__CONVERT_0_DST_1_SRC_DROP) {
+          // No-op.
+        } else if (vbd &
+                   WUFFS_BASE__TOKEN__VBD__STRING__CONVERT_1_DST_1_SRC_COPY) {
+          str_.append(reinterpret_cast<const char*>(token_ptr),
+                      static_cast<size_t>(token_len));
+        } else {
+          break;
+        }
+        if (token.continued()) {
+          return pybind11::object();
+        }
+        return AppendString();
+
+      case WUFFS_BASE__TOKEN__VBC__UNICODE_CODE_POINT: {
+        uint8_t u[WUFFS_BASE__UTF_8__BYTE_LENGTH__MAX_INCL];
+        const size_t n = wuffs_base__utf_8__encode(
+            wuffs_base__make_slice_u8(&u[0],
+                                      WUFFS_BASE__UTF_8__BYTE_LENGTH__MAX_INCL),
+            static_cast<uint32_t>(vbd));
+        str_.append(reinterpret_cast<const char*>(&u[0]), n);
+        if (token.continued()) {
+          return pybind11::object();
+        }
+        break;
+      }
+
+      case WUFFS_BASE__TOKEN__VBC__LITERAL:
+        if (vbd & WUFFS_BASE__TOKEN__VBD__LITERAL__NULL) {
+          return Append(kNull, [] { return pybind11::none(); });
+        } else if (vbd & WUFFS_BASE__TOKEN__VBD__LITERAL__FALSE) {
+          return Append(kBoolean, [] { return pybind11::bool_(false); });
+        } else if (vbd & WUFFS_BASE__TOKEN__VBD__LITERAL__TRUE) {
+          return Append(kBoolean, [] { return pybind11::bool_(true); });
+        }
+        break;
+
+      case WUFFS_BASE__TOKEN__VBC__NUMBER:
+        if (vbd & WUFFS_BASE__TOKEN__VBD__NUMBER__FORMAT_TEXT) {
+          if (vbd & WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_INTEGER_SIGNED) {
+            const wuffs_base__result_i64 r = wuffs_base__parse_number_i64(
+                wuffs_base__make_slice_u8(token_ptr, token_len),
+                WUFFS_BASE__PARSE_NUMBER_XXX__DEFAULT_OPTIONS);
+            if (r.status.is_ok()) {
+              const int64_t val = r.value;
+              return Append(kNumber, [val] { return pybind11::int_(val); });
+            }
+          }
+          if (vbd & WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_FLOATING_POINT) {
+            const wuffs_base__result_f64 r = wuffs_base__parse_number_f64(
+                wuffs_base__make_slice_u8(token_ptr, token_len),
+                WUFFS_BASE__PARSE_NUMBER_XXX__DEFAULT_OPTIONS);
+            if (r.status.is_ok()) {
+              const double val = r.value;
+              return Append(kNumber, [val] { return pybind11::float_(val); });
+            }
+          }
+        } else if (vbd & (WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_NEG_INF |
+                          WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_POS_INF |
+                          WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_NEG_NAN |
+                          WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_POS_NAN)) {
+          const double val =
+              (vbd & WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_NEG_INF)
+                  ? -std::numeric_limits<double>::infinity()
+              : (vbd & WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_POS_INF)
+                  ? std::numeric_limits<double>::infinity()
+              : (vbd & WUFFS_BASE__TOKEN__VBD__NUMBER__CONTENT_NEG_NAN)
+                  ? -std::numeric_limits<double>::quiet_NaN()
+                  : std::numeric_limits<double>::quiet_NaN();
+          return Append(kNumber, [val] { return pybind11::float_(val); });
+        }
+        break;
+    }
+    Fail("wuffs_aux_wrap::JsonEventParser: internal error: unexpected token");
+    return pybind11::object();
+  }
+
+  pybind11::object Push(bool is_map) {
+    pybind11::object event = MakeEvent(is_map ? kStartMap : kStartArray,
+                                       [] { return pybind11::none(); });
+    frames_.push_back({is_map, is_map, prefix_.size()});
+    if (!is_map) {
+      prefix_.append(prefix_.empty() ? "item" : ".item");
+    }
+    return event;
+  }
+
+  pybind11::object Pop() {
+    if (frames_.empty()) {
+      Fail("wuffs_aux_wrap::JsonEventParser: internal error: bad pop");
+      return pybind11::object();
+    }
+    const Frame frame = frames_.back();
+    frames_.pop_back();
+    prefix_.resize(frame.prefix_length);
+    pybind11::object event = MakeEvent(frame.is_map ? kEndMap : kEndArray,
+                                       [] { return pybind11::none(); });
+    EndValue();
+    return event;
+  }
+
+  pybind11::object AppendString() {
+    if (!frames_.empty() && frames_.back().expects_key) {
+      Frame& frame = frames_.back();
+      frame.expects_key = false;
+      pybind11::object event = MakeEvent(
+          kMapKey, [this] { return pybind11::str(str_); });
+      if (frame.prefix_length > 0) {
+        prefix_.push_back('.');
+      }
+      prefix_.append(str_);
+      str_.clear();
+      return event;
+    }
+    pybind11::object event =
+        Append(kString, [this] { return pybind11::str(str_); });
+    str_.clear();
+    return event;
+  }
+
+  template <typename Func>
+  pybind11::object Append(Event event_type, const Func& make_value) {
+    pybind11::object event = MakeEvent(event_type, make_value);
+    EndValue();
+    return event;
+  }
+
+  // Moves on to the next key after a value inside a map.
+  void EndValue() {
+    if (!frames_.empty() && frames_.back().is_map) {
+      prefix_.resize(frames_.back().prefix_length);
+      frames_.back().expects_key = true;
+    }
+  }
+
+  // Creates the event tuple if the current prefix matches the filter. Values
+  // are only created for the matching events.
+  template <typename Func>
+  pybind11::object MakeEvent(Event event_type, const Func& make_value) {
+    if (!prefix_filter_.empty() &&
+        !((prefix_.size() >= prefix_filter_.size()) &&
+          (prefix_.compare(0, prefix_filter_.size(), prefix_filter_) == 0) &&
+          ((prefix_.size() == prefix_filter_.size()) ||
+           (prefix_[prefix_filter_.size()] == '.')))) {
+      return pybind11::object();
+    }
+    return pybind11::make_tuple(pybind11::str(prefix_),
+                                event_names_[event_type], make_value());
+  }
+
+  void Fail(std::string error_message) {
+    error_message_ = std::move(error_message);
+    done_ = true;
+  }
+
+  static constexpr size_t kTokenBufferSize = 256;
+
+  std::unique_ptr<wuffs_aux::sync_io::Input> input_;
+  std::unique_ptr<DecompressingInput> decompressing_input_;
+  // The decompressed input_
+  wuffs_aux::sync_io::Input* source_ = nullptr;
+  FILE* file_ = nullptr;
+  std::string prefix_filter_;
+  std::vector<pybind11::str> event_names_;
+  wuffs_json__decoder::unique_ptr json_decoder_;
+  std::unique_ptr<uint8_t[]> io_array_;
+  wuffs_base__io_buffer fallback_io_buf_;
+  wuffs_base__io_buffer* io_buf_ = nullptr;
+  wuffs_base__token tok_array_[kTokenBufferSize];
+  wuffs_base__token_buffer tok_buf_;
+  wuffs_base__status tok_status_;
+  // Offset of the next token in io_buf_
+  uint64_t cursor_index_ = 0;
+  // Pending string value or map key
+  std::string str_;
+  // Prefix of the next value
+  std::string prefix_;
+  std::vector<Frame> frames_;
+  std::string error_message_;
+  bool done_ = false;
+};
+
 }  // namespace wuffs_aux_wrap
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// This API implements the opt-in per-decode timing breakdown and the
+// process-wide decoding metrics.
+
+namespace wuffs_aux_wrap {
+
+using Clock = std::chrono::steady_clock;
+
+inline double SecondsBetween(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double>(end - start).count();
+}
+
+// Timing breakdown of a single decode
+struct DecodingStats {
+  // Phase names and durations in seconds, in the order of the phases
+  std::vector<std::pair<std::string, double>> phases;
+  uint64_t input_bytes = 0;
+  uint64_t output_bytes = 0;
+
+  void AddPhase(const std::string& name, Clock::time_point start,
+                Clock::time_point end) {
+    phases.emplace_back(name, SecondsBetween(start, end));
+  }
+
+  // Replaces the duration of the given phase, appends it if it's missing.
+  void SetPhase(const std::string& name, double seconds) {
+    for (auto& phase : phases) {
+      if (phase.first == name) {
+        phase.second = seconds;
+        return;
+      }
+    }
+    phases.emplace_back(name, seconds);
+  }
+};
+
+// Cumulative metrics of a decoder type
+struct DecoderMetrics {
+  static constexpr size_t kNumLatencyBuckets = 32;
+
+  uint64_t count = 0;
+  uint64_t errors = 0;
+  uint64_t input_bytes = 0;
+  double total_seconds = 0;
+  // Bucket i counts the decodes which took less than 2^i microseconds (and
+  // at least 2^(i-1) microseconds for i > 0), the last bucket counts the
+  // slower ones as well
+  std::array<uint64_t, kNumLatencyBuckets> latency_histogram{};
+
+  void Add(const DecoderMetrics& other) {
+    count += other.count;
+    errors += other.errors;
+    input_bytes += other.input_bytes;
+    total_seconds += other.total_seconds;
+    for (size_t i = 0; i < kNumLatencyBuckets; i++) {
+      latency_histogram[i] += other.latency_histogram[i];
+    }
+  }
+};
+
+struct MetricsSnapshot {
+  // Keyed by decoder type name (e.g. "PNG" or "JSON")
+  std::map<std::string, DecoderMetrics> decoders;
+  // Keyed by error message
+  std::map<std::string, uint64_t> errors;
+
+  void Add(const MetricsSnapshot& other) {
+    for (const auto& decoder : other.decoders) {
+      decoders[decoder.first].Add(decoder.second);
+    }
+    for (const auto& error : other.errors) {
+      errors[error.first] += error.second;
+    }
+  }
+};
+
+// Returns the key under which the error message is recorded: the first of
+// the given fixed errors the message starts with, the message itself
+// otherwise. This keeps the variable details appended to a fixed error (e.g.
+// a map key from the input or the text of a Python exception) out of the
+// process-wide error map.
+inline const std::string& ErrorMetricsKey(
+    const std::string& error_message,
+    std::initializer_list<const std::string*> fixed_errors) {
+  for (const std::string* fixed_error : fixed_errors) {
+    if (error_message.compare(0, fixed_error->size(), *fixed_error) == 0) {
+      return *fixed_error;
+    }
+  }
+  return error_message;
+}
+
+// Process-wide metrics registry. Every thread records into its own counters,
+// guarded by a mutex which is only contended while taking a snapshot, so
+// recording is cheap enough to be always on.
+class Metrics {
+ public:
+  static void Record(const std::string& decoder, uint64_t input_bytes,
+                     double seconds, const std::string& error_message) {
+    ThreadMetrics& thread_metrics = GetThreadMetrics();
+    std::lock_guard<std::mutex> lock(thread_metrics.mutex);
+    DecoderMetrics& metrics = thread_metrics.snapshot.decoders[decoder];
+    metrics.count++;
+    metrics.input_bytes += input_bytes;
+    metrics.total_seconds += seconds;
+    metrics.latency_histogram[LatencyBucket(seconds)]++;
+    if (!error_message.empty()) {
+      metrics.errors++;
+      thread_metrics.snapshot.errors[error_message]++;
+    }
+  }
+
+  static MetricsSnapshot Snapshot() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    MetricsSnapshot snapshot = registry.retired;
+    for (ThreadMetrics* thread_metrics : registry.threads) {
+      std::lock_guard<std::mutex> thread_lock(thread_metrics->mutex);
+      snapshot.Add(thread_metrics->snapshot);
+    }
+    return snapshot;
+  }
+
+  static void Reset() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.retired = MetricsSnapshot();
+    for (ThreadMetrics* thread_metrics : registry.threads) {
+      std::lock_guard<std::mutex> thread_lock(thread_metrics->mutex);
+      thread_metrics->snapshot = MetricsSnapshot();
+    }
+  }
+
+ private:
+  struct ThreadMetrics;
+
+  struct Registry {
+    std::mutex mutex;
+    std::unordered_set<ThreadMetrics*> threads;
+    // Metrics of the exited threads
+    MetricsSnapshot retired;
+  };
+
+  struct ThreadMetrics {
+    ThreadMetrics() {
+      Registry& registry = GetRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      registry.threads.insert(this);
+    }
+
+    ~ThreadMetrics() {
+      Registry& registry = GetRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      registry.threads.erase(this);
+      registry.retired.Add(snapshot);
+    }
+
+    std::mutex mutex;
+    MetricsSnapshot snapshot;
+  };
+
+  // The registry is never destroyed, so that the threads exiting after the
+  // static destructors can still use it
+  static Registry& GetRegistry() {
+    static Registry* registry = new Registry();
+    return *registry;
+  }
+
+  static ThreadMetrics& GetThreadMetrics() {
+    thread_local ThreadMetrics thread_metrics;
+    return thread_metrics;
+  }
+
+  static size_t LatencyBucket(double seconds) {
+    constexpr size_t kLastBucket = DecoderMetrics::kNumLatencyBuckets - 1;
+    size_t bucket = 0;
+    for (double us = seconds * 1e6; (us >= 1) && (bucket < kLastBucket);
+         us /= 2) {
+      bucket++;
+    }
+    return bucket;
+  }
+};
+
+}  // namespace wuffs_aux_wrap
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <pybind11/pybind11.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "wuffs-aux-codecs.h"
+
+// This API implements reading the decoders' input from Python binary file-like
+// objects.
+
+namespace wuffs_aux_wrap {
+
+// This class implements wuffs_aux::sync_io::Input for a Python binary
+// file-like object (e.g. io.BufferedReader, socket.makefile("rb"), tarfile and
+// zipfile members or HTTP responses). The object is read in chunks of up to
+// chunk_size bytes with readinto (or read if it's missing) straight into the
+// decoder's IO buffer, so that only one chunk is held in memory at a time. The
+// GIL is only held around each read, so the decoding may go on with the GIL
+// released in between. A Python exception raised by a read is reported as
+// read_error followed by the exception text, read_error being the decoder's
+// fixed "failed to read file" error.
+class PythonFileInput : public wuffs_aux::sync_io::Input {
+ public:
+  static constexpr size_t kChunkSize = 64 * 1024;
+
+  // Must be called with the GIL held.
+  PythonFileInput(const pybind11::object& file, const std::string& read_error,
+                  size_t chunk_size = kChunkSize)
+      : file_(file),
+        read_error_(read_error),
+        chunk_size_(std::max<size_t>(chunk_size, 1)) {
+    if (pybind11::hasattr(file_, "readinto")) {
+      readinto_ = file_.attr("readinto");
+    } else {
+      read_ = file_.attr("read");
+    }
+  }
+
+  // May be called with the GIL released.
+  ~PythonFileInput() override {
+    pybind11::gil_scoped_acquire acquire_gil;
+    readinto_ = pybind11::object();
+    read_ = pybind11::object();
+    file_ = pybind11::object();
+  }
+
+  PythonFileInput(const PythonFileInput& other) = delete;
+  PythonFileInput& operator=(const PythonFileInput& other) = delete;
+
+  // Whether the object can be read by this class.
+  static bool IsFileLike(const pybind11::object& file) {
+    return pybind11::hasattr(file, "readinto") ||
+           pybind11::hasattr(file, "read");
+  }
+
+  std::string CopyIn(wuffs_aux::IOBuffer* dst) override {
+    if (!dst) {
+      return "wuffs_aux_wrap::PythonFileInput: nullptr IOBuffer";
+    } else if (dst->meta.closed) {
+      return "wuffs_aux_wrap::PythonFileInput: end of file";
+    }
+    dst->compact();
+    if (dst->writer_length() == 0) {
+      return "wuffs_aux_wrap::PythonFileInput: IOBuffer is full";
+    }
+    const size_t n = Read(dst->writer_pointer(), dst->writer_length());
+    if (!error_message_.empty()) {
+      return error_message_;
+    } else if (n == 0) {
+      dst->meta.closed = true;
+    }
+    dst->meta.wi += n;
+    return "";
+  }
+
+  // Reads up to min(size, chunk_size) bytes into dst. Returns the number of
+  // bytes read, 0 on EOF or on error (see error_message).
+  size_t Read(uint8_t* dst, size_t size) {
+    if (!error_message_.empty()) {
+      return 0;
+    }
+    size = std::min(size, chunk_size_);
+    pybind11::gil_scoped_acquire acquire_gil;
+    size_t n = 0;
+    try {
+      pybind11::object result;
+      // Whether the result is a number of bytes (for readinto) or bytes
+      bool is_binary = false;
+      if (readinto_) {
+        pybind11::memoryview view = pybind11::memoryview::from_memory(
+            dst, static_cast<pybind11::ssize_t>(size), false);
+        result = readinto_(view);
+        // The view must not outlive this call
+        view.attr("release")();
+        if (pybind11::isinstance<pybind11::int_>(result)) {
+          is_binary = true;
+          n = std::min(result.cast<size_t>(), size);
+        }
+      } else {
+        result = read_(size);
+        char* data = nullptr;
+        pybind11::ssize_t length = 0;
+        if (pybind11::isinstance<pybind11::bytes>(result) &&
+            (PyBytes_AsStringAndSize(result.ptr(), &data, &length) == 0)) {
+          is_binary = true;
+          n = std::min(static_cast<size_t>(length), size);
+          std::memcpy(dst, data, n);
+        }
+      }
+      if (result.is_none()) {
+        error_message_ =
+            "wuffs_aux_wrap::PythonFileInput: non-blocking read with no data";
+        return 0;
+      } else if (!is_binary) {
+        error_message_ =
+            "wuffs_aux_wrap::PythonFileInput: the file-like object is not "
+            "binary";
+        return 0;
+      }
+    } catch (pybind11::error_already_set& e) {
+      error_message_ = read_error_ + ": " + e.what();
+      return 0;
+    }
+    bytes_read_ += n;
+    return n;
+  }
+
+  const std::string& error_message() const { return error_message_; }
+
+  // The number of bytes read so far
+  uint64_t bytes_read() const { return bytes_read_; }
+
+ private:
+  pybind11::object file_;
+  pybind11::object readinto_;
+  pybind11::object read_;
+  std::string read_error_;
+  size_t chunk_size_;
+  std::string error_message_;
+  uint64_t bytes_read_ = 0;
+};
+
+}  // namespace wuffs_aux_wrap
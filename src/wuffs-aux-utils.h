@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <map>
+#include <thread>
 #include <vector>
 
 namespace utils {
@@ -18,4 +21,37 @@ std::vector<wuffs_aux::QuirkKeyValuePair> ConvertQuirks(
   return quirks_vector;
 }
 
+// Runs func(i) for every i in [0, num_items) on up to num_threads native
+// threads (0 stands for the number of hardware threads), the calling thread
+// included. Items are handed out one by one, so that a few large items don't
+// stall the other threads.
+template <typename Func>
+void ParallelFor(size_t num_items, size_t num_threads, const Func& func) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = std::min(num_threads, num_items);
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < num_items; i++) {
+      func(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next_item(0);
+  auto worker = [&]() {
+    for (size_t i = next_item++; i < num_items; i = next_item++) {
+      func(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads - 1);
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 }  // namespace utils
\ No newline at end of file
@@ -1,18 +1,299 @@
 #define WUFFS_IMPLEMENTATION
 
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
-#include <wuffs-unsupported-snapshot.c>
+#include "wuffs-aux-codecs.h"
+#include "wuffs-aux-decompressor-wrapper.h"
+#include "wuffs-aux-hash-wrapper.h"
+#include "wuffs-aux-metrics.h"
+#include "wuffs-aux-python-input.h"
 
+// Only the wrappers of the compiled codecs are bound (see wuffs-aux-codecs.h)
+#if defined(PYWUFFS_CODEC_CBOR)
+#include "wuffs-aux-cbor-wrapper.h"
+#endif
+#if defined(PYWUFFS_CODEC_ANY_IMAGE)
 #include "wuffs-aux-image-wrapper.h"
+#endif
+#if defined(PYWUFFS_CODEC_JSON)
 #include "wuffs-aux-json-wrapper.h"
+#endif
 
 namespace py = pybind11;
 
+namespace {
+
+#if defined(PYWUFFS_CODEC_JSON)
+wuffs_aux_wrap::JsonColumnarSchema ConvertColumnarSchema(
+    const py::dict& schema) {
+  wuffs_aux_wrap::JsonColumnarSchema columnar_schema;
+  for (const auto& field : schema) {
+    columnar_schema.emplace_back(
+        field.first.cast<std::string>(),
+        field.second.cast<wuffs_aux_wrap::JsonColumnType>());
+  }
+  return columnar_schema;
+}
+#endif
+
+// Returns the memory of a C-contiguous buffer.
+wuffs_aux_wrap::Buffer GetContiguousBuffer(const py::buffer_info& info) {
+  py::ssize_t stride = info.itemsize;
+  for (py::ssize_t i = info.ndim - 1; i >= 0; i--) {
+    if ((info.shape[i] > 1) && (info.strides[i] != stride)) {
+      throw py::value_error("buffer is not C-contiguous");
+    }
+    stride *= info.shape[i];
+  }
+  return {reinterpret_cast<const uint8_t*>(info.ptr),
+          static_cast<size_t>(info.size * info.itemsize)};
+}
+
+// Wraps a binary file-like object for the decoders, raises TypeError if it
+// isn't one. The read errors start with the decoder's read_error.
+std::unique_ptr<wuffs_aux_wrap::PythonFileInput> MakePythonFileInput(
+    const py::object& file, const std::string& read_error) {
+  if (!wuffs_aux_wrap::PythonFileInput::IsFileLike(file)) {
+    throw py::type_error(
+        "expected bytes, a file path or a binary file-like object");
+  }
+  return std::unique_ptr<wuffs_aux_wrap::PythonFileInput>(
+      new wuffs_aux_wrap::PythonFileInput(file, read_error));
+}
+
+py::object DigestToPython(uint64_t digest) { return py::int_(digest); }
+
+py::object DigestToPython(const std::array<uint8_t, 32>& digest) {
+  return py::bytes(reinterpret_cast<const char*>(digest.data()),
+                   digest.size());
+}
+
+// Reports the SIMD code paths compiled into Wuffs and the CPU features
+// detected at runtime. Wuffs selects its SIMD implementations (e.g. for CRC-32,
+// Adler-32, the pixel swizzler and the JPEG IDCT) at runtime, so a path is
+// active if it's both compiled and supported by the CPU.
+py::dict BuildInfo() {
+  py::dict compiled;
+  py::dict detected;
+  // Wuffs only compiles its x86 SIMD code paths for x86-64 (not for 32-bit
+  // x86), and with MSVC proper only gets the AVX2 ones with /arch:AVX2: the
+  // WUFFS_CONFIG__ENABLE_MSVC_CPU_ARCH__X86_64_V2 opt-in stops at SSE4.2.
+#if defined(WUFFS_BASE__CPU_ARCH__X86_64)
+  compiled["x86_sse42"] = true;
+#if !defined(_MSC_VER) || defined(__clang__) || defined(__AVX2__)
+  compiled["x86_avx2"] = true;
+#endif
+#endif
+#if defined(WUFFS_BASE__CPU_ARCH__X86_FAMILY)
+  detected["x86_sse42"] = wuffs_base__cpu_arch__have_x86_sse42();
+  detected["x86_avx2"] = wuffs_base__cpu_arch__have_x86_avx2();
+  detected["x86_bmi2"] = wuffs_base__cpu_arch__have_x86_bmi2();
+#endif
+#if defined(WUFFS_BASE__CPU_ARCH__ARM_NEON)
+  compiled["arm_neon"] = true;
+  detected["arm_neon"] = wuffs_base__cpu_arch__have_arm_neon();
+#endif
+#if defined(WUFFS_BASE__CPU_ARCH__ARM_CRC32)
+  compiled["arm_crc32"] = true;
+  detected["arm_crc32"] = wuffs_base__cpu_arch__have_arm_crc32();
+#endif
+  py::list active;
+  for (const auto& path : compiled) {
+    if (detected.contains(path.first) && detected[path.first].cast<bool>()) {
+      active.append(path.first);
+    }
+  }
+  py::dict info;
+  info["wuffs_version"] = WUFFS_VERSION_STRING;
+#if defined(_MSC_VER)
+  info["compiler"] = "MSVC " + std::to_string(_MSC_VER);
+#elif defined(__VERSION__)
+  info["compiler"] = __VERSION__;
+#else
+  info["compiler"] = "unknown";
+#endif
+  info["codecs"] = wuffs_aux_wrap::CompiledCodecs();
+  info["compiled_simd_paths"] = py::list(compiled.attr("keys")());
+  info["cpu_features"] = detected;
+  info["active_simd_paths"] = active;
+  return info;
+}
+
+// Returns None if the stats weren't collected.
+py::object StatsToPython(const wuffs_aux_wrap::DecodingStats& stats) {
+  if (stats.phases.empty()) {
+    return py::none();
+  }
+  py::dict phases;
+  for (const auto& phase : stats.phases) {
+    phases[py::str(phase.first)] = phase.second;
+  }
+  py::dict result;
+  result["phases"] = phases;
+  result["input_bytes"] = stats.input_bytes;
+  result["output_bytes"] = stats.output_bytes;
+  return result;
+}
+
+#if defined(PYWUFFS_CODEC_ANY_IMAGE)
+// Returns None if no statistics were computed, otherwise a dict holding only
+// the computed ones.
+py::object StatisticsToPython(
+    const wuffs_aux_wrap::ImageStatistics& statistics) {
+  using wuffs_aux_wrap::ImageStatistic;
+  if (statistics.computed == 0) {
+    return py::none();
+  }
+  py::dict result;
+  if (statistics.has(ImageStatistic::LUMA_HISTOGRAM)) {
+    result["luma_histogram"] = py::array_t<uint64_t>(
+        statistics.luma_histogram.size(), statistics.luma_histogram.data());
+  }
+  if (statistics.has(ImageStatistic::MEAN_STD)) {
+    result["mean"] = py::cast(statistics.mean);
+    result["std"] = py::cast(statistics.stddev);
+  }
+  if (statistics.has(ImageStatistic::MIN_MAX)) {
+    result["min"] = py::cast(statistics.minimum);
+    result["max"] = py::cast(statistics.maximum);
+  }
+  if (statistics.has(ImageStatistic::DHASH)) {
+    result["dhash"] = statistics.dhash;
+  }
+  if (statistics.has(ImageStatistic::PHASH)) {
+    result["phash"] = statistics.phash;
+  }
+  return result;
+}
+#endif
+
+py::dict Metrics() {
+  const wuffs_aux_wrap::MetricsSnapshot snapshot =
+      wuffs_aux_wrap::Metrics::Snapshot();
+  py::dict decoders;
+  for (const auto& decoder : snapshot.decoders) {
+    const wuffs_aux_wrap::DecoderMetrics& metrics = decoder.second;
+    py::dict entry;
+    entry["count"] = metrics.count;
+    entry["errors"] = metrics.errors;
+    entry["input_bytes"] = metrics.input_bytes;
+    entry["total_seconds"] = metrics.total_seconds;
+    entry["latency_histogram"] = py::cast(std::vector<uint64_t>(
+        metrics.latency_histogram.begin(), metrics.latency_histogram.end()));
+    decoders[py::str(decoder.first)] = entry;
+  }
+  py::dict errors;
+  for (const auto& error : snapshot.errors) {
+    errors[py::str(error.first)] = error.second;
+  }
+  py::dict result;
+  result["decoders"] = decoders;
+  result["errors"] = errors;
+  return result;
+}
+
+// Binds the one-shot function, its batch overload and the incremental hasher
+// class.
+template <typename HasherType>
+void BindHasher(py::module& hash_m, const char* function_name,
+                const char* function_doc, const char* class_name,
+                const char* class_doc) {
+  hash_m.def(
+      function_name,
+      [](const py::buffer& data) {
+        py::buffer_info data_view(data.request());
+        const wuffs_aux_wrap::Buffer buffer = GetContiguousBuffer(data_view);
+        return DigestToPython(HasherType::Hash(buffer.first, buffer.second));
+      },
+      py::arg("data"), function_doc);
+  hash_m.def(
+      function_name,
+      [](const std::vector<py::buffer>& data, size_t num_threads) {
+        std::vector<py::buffer_info> data_views;
+        std::vector<wuffs_aux_wrap::Buffer> buffers;
+        data_views.reserve(data.size());
+        buffers.reserve(data.size());
+        for (const auto& d : data) {
+          data_views.emplace_back(d.request());
+          buffers.push_back(GetContiguousBuffer(data_views.back()));
+        }
+        py::list digests;
+        for (const auto& digest : HasherType::HashMany(buffers, num_threads)) {
+          digests.append(DigestToPython(digest));
+        }
+        return digests;
+      },
+      py::arg("data"), py::arg("num_threads") = 0,
+      "Batch form: hashes every buffer of the list on native threads and "
+      "returns the list of digests, in the input order.\n\n"
+      "Args:"
+      "\n data (list): a list of buffers."
+      "\n num_threads (int): maximum number of threads to use, 0 (the "
+      "default) stands for the number of hardware threads.");
+  py::class_<HasherType>(hash_m, class_name, class_doc)
+      .def(py::init<>())
+      .def(
+          "update",
+          [](HasherType& hasher, const py::buffer& data) {
+            py::buffer_info data_view(data.request());
+            const wuffs_aux_wrap::Buffer buffer =
+                GetContiguousBuffer(data_view);
+            hasher.Update(buffer.first, buffer.second);
+          },
+          py::arg("data"),
+          "Hashes the next chunk of data, with the GIL released unless it's "
+          "smaller than 2 KiB. The hasher may be shared between threads, the "
+          "updates being serialized.\n\n"
+          "Args:"
+          "\n data (buffer): any C-contiguous buffer (bytes, bytearray, "
+          "memoryview, NumPy array, etc.).")
+      .def(
+          "digest",
+          [](const HasherType& hasher) {
+            return DigestToPython(hasher.Checksum());
+          },
+          "Returns the digest of the data hashed so far.")
+      .def("reset", &HasherType::Reset, "Starts hashing anew.");
+}
+
+}  // namespace
+
 PYBIND11_MODULE(pywuffs, m) {
   m.doc() = "Python bindings for Wuffs the Library.";
 
+  m.def("build_info", &BuildInfo,
+        "Returns the build information as a dict with the following keys:"
+        "\n - \"wuffs_version\": Wuffs version string."
+        "\n - \"compiler\": compiler the module was built with."
+        "\n - \"codecs\": codecs compiled into the module (see "
+        "PYWUFFS_CODECS in the build instructions)."
+        "\n - \"compiled_simd_paths\": SIMD code paths compiled into Wuffs "
+        "(e.g. \"x86_avx2\" or \"arm_neon\")."
+        "\n - \"cpu_features\": dict of CPU features detected at runtime."
+        "\n - \"active_simd_paths\": the compiled paths supported by the "
+        "CPU, which Wuffs dispatches to at runtime.");
+
+  m.def("metrics", &Metrics,
+        "Returns a snapshot of the process-wide decoding metrics, cumulative "
+        "since the module was loaded or reset_metrics was called, as a dict "
+        "with the following keys:"
+        "\n - \"decoders\": dict mapping decoder type names (ImageDecoderType "
+        "names, \"UNKNOWN\" for unrecognized images, and \"JSON\") to dicts "
+        "with the \"count\", \"errors\", \"input_bytes\" and "
+        "\"total_seconds\" counters and the \"latency_histogram\" list, "
+        "whose element i counts the decodes which took less than 2**i "
+        "microseconds (and at least 2**(i-1) for i > 0, the last element "
+        "counts the slower ones as well)."
+        "\n - \"errors\": dict mapping error messages to their counts."
+        "\nThe counters are kept per thread, so recording doesn't contend.");
+  m.def("reset_metrics", &wuffs_aux_wrap::Metrics::Reset,
+        "Resets the process-wide decoding metrics.");
+
+  py::module aux_m = m.def_submodule("aux", "Simplified \"auxiliary\" API.");
+
+#if defined(PYWUFFS_CODEC_ANY_IMAGE)
   /*
    * Base Wuffs API
    */
@@ -66,6 +347,7 @@ PYBIND11_MODULE(pywuffs, m) {
       .value("IGNORE_CHECKSUM",
              wuffs_aux_wrap::ImageDecoderQuirks::IGNORE_CHECKSUM,
              "Favor faster decodes over rejecting invalid checksums.")
+#if defined(PYWUFFS_CODEC_GIF)
       .value("GIF_DELAY_NUM_DECODED_FRAMES",
              wuffs_aux_wrap::ImageDecoderQuirks::GIF_DELAY_NUM_DECODED_FRAMES)
       .value("GIF_FIRST_FRAME_LOCAL_PALETTE_MEANS_BLACK_BACKGROUND",
@@ -82,23 +364,49 @@ PYBIND11_MODULE(pywuffs, m) {
              wuffs_aux_wrap::ImageDecoderQuirks::GIF_REJECT_EMPTY_FRAME)
       .value("GIF_REJECT_EMPTY_PALETTE",
              wuffs_aux_wrap::ImageDecoderQuirks::GIF_REJECT_EMPTY_PALETTE)
+#endif
       .value("QUALITY", wuffs_aux_wrap::ImageDecoderQuirks::QUALITY,
              "Configures decoders (for a lossy format, where there is some "
              "leeway in \"a/the correct decoding\") to use lower than, equal "
              "to or higher than the default quality setting.");
 
   py::enum_<wuffs_aux_wrap::ImageDecoderType>(m, "ImageDecoderType")
+  // clang-format off
+#if defined(PYWUFFS_CODEC_BMP)
       .value("BMP", wuffs_aux_wrap::ImageDecoderType::BMP)
+#endif
+#if defined(PYWUFFS_CODEC_GIF)
       .value("GIF", wuffs_aux_wrap::ImageDecoderType::GIF)
+#endif
+#if defined(PYWUFFS_CODEC_NIE)
       .value("NIE", wuffs_aux_wrap::ImageDecoderType::NIE)
+#endif
+#if defined(PYWUFFS_CODEC_PNG)
       .value("PNG", wuffs_aux_wrap::ImageDecoderType::PNG)
+#endif
+#if defined(PYWUFFS_CODEC_TGA)
       .value("TGA", wuffs_aux_wrap::ImageDecoderType::TGA)
+#endif
+#if defined(PYWUFFS_CODEC_WBMP)
       .value("WBMP", wuffs_aux_wrap::ImageDecoderType::WBMP)
+#endif
+#if defined(PYWUFFS_CODEC_JPEG)
       .value("JPEG", wuffs_aux_wrap::ImageDecoderType::JPEG)
+#endif
+#if defined(PYWUFFS_CODEC_WEBP)
       .value("WEBP", wuffs_aux_wrap::ImageDecoderType::WEBP)
+#endif
+#if defined(PYWUFFS_CODEC_QOI)
       .value("QOI", wuffs_aux_wrap::ImageDecoderType::QOI)
+#endif
+#if defined(PYWUFFS_CODEC_ETC2)
       .value("ETC2", wuffs_aux_wrap::ImageDecoderType::ETC2)
-      .value("TH", wuffs_aux_wrap::ImageDecoderType::TH);
+#endif
+#if defined(PYWUFFS_CODEC_TH)
+      .value("TH", wuffs_aux_wrap::ImageDecoderType::TH)
+#endif
+      // clang-format on
+      ;
 
   m.attr("LowerQuality") = wuffs_aux_wrap::kLowerQuality;
   m.attr("HigherQuality") = wuffs_aux_wrap::kHigherQuality;
@@ -170,8 +478,6 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
    * Aux Wuffs API (DecodeImage)
    */
 
-  py::module aux_m = m.def_submodule("aux", "Simplified \"auxiliary\" API.");
-
   py::enum_<wuffs_aux_wrap::ImageDecoderFlags>(
       aux_m, "ImageDecoderFlags",
       "Flags to defining image decoder behavior (e.g. metadata reporting).")
@@ -211,6 +517,26 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
              wuffs_aux_wrap::ImageDecoderFlags::REPORT_METADATA_XMP,
              "Extensible Metadata Platform.");
 
+  py::enum_<wuffs_aux_wrap::ImageStatistic>(
+      aux_m, "ImageStatistic",
+      "Statistics computed over the decoded pixels (see "
+      "ImageDecoderConfig.compute).")
+      .value("LUMA_HISTOGRAM", wuffs_aux_wrap::ImageStatistic::LUMA_HISTOGRAM,
+             "256-bin histogram of the luma, i.e. (77 * R + 150 * G + 29 * B "
+             "+ 128) >> 8 for color formats and Y for gray ones.")
+      .value("MEAN_STD", wuffs_aux_wrap::ImageStatistic::MEAN_STD,
+             "Per-channel mean and standard deviation.")
+      .value("MIN_MAX", wuffs_aux_wrap::ImageStatistic::MIN_MAX,
+             "Per-channel minimum and maximum.")
+      .value("DHASH", wuffs_aux_wrap::ImageStatistic::DHASH,
+             "64-bit difference hash: the luma is averaged down to 9x8 cells "
+             "and each bit tells whether a cell is brighter than its left "
+             "neighbor.")
+      .value("PHASH", wuffs_aux_wrap::ImageStatistic::PHASH,
+             "64-bit perceptual hash: the luma is averaged down to 32x32 "
+             "cells and each bit tells whether one of the 8x8 lowest "
+             "frequency DCT coefficients is above their median.");
+
   py::class_<wuffs_aux_wrap::MetadataEntry>(aux_m, "MetadataEntry",
                                             "Holds parsed metadata piece.")
       .def_readonly("minfo", &wuffs_aux_wrap::MetadataEntry::minfo,
@@ -277,7 +603,51 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
           "- PixelFormat.BGRA_NONPREMUL_4X16LE\n"
           "- PixelFormat.BGRA_PREMUL\n"
           "- PixelFormat.RGBA_NONPREMUL\n"
-          "- PixelFormat.RGBA_PREMUL");
+          "- PixelFormat.RGBA_PREMUL")
+      .def_readwrite(
+          "compression", &wuffs_aux_wrap::ImageDecoderConfig::compression,
+          "InputCompression: compression of the input (e.g. gzip-wrapped "
+          "image blobs), default is InputCompression.NONE. The input is "
+          "decompressed on the fly, without holding the whole decompressed "
+          "data.")
+      .def_readwrite(
+          "collect_stats", &wuffs_aux_wrap::ImageDecoderConfig::collect_stats,
+          "bool: if True, ImageDecodingResult.stats holds the timing "
+          "breakdown of the decode, False by default.")
+      .def_readwrite(
+          "crop", &wuffs_aux_wrap::ImageDecoderConfig::crop,
+          "tuple: region of interest as (x, y, width, height), default is "
+          "(0, 0, 0, 0) which means no cropping. Only this region (clipped "
+          "to the image bounds, after applying apply_exif_orientation) is "
+          "returned in ImageDecodingResult.pixbuf, decoding fails with "
+          "ImageDecoderError.CropOutOfBounds if it doesn't overlap the "
+          "image. The whole frame is still decoded, into a scratch buffer "
+          "reused by the following decodes.")
+      .def_readwrite(
+          "apply_exif_orientation",
+          &wuffs_aux_wrap::ImageDecoderConfig::apply_exif_orientation,
+          "bool: if True, the EXIF orientation tag (of the PNG eXIf chunk or "
+          "of the JPEG APP1 segment, which is only looked for in the first "
+          "chunk of input read) is applied to ImageDecodingResult.pixbuf, "
+          "i.e. the image is rotated and/or flipped while being copied out of "
+          "the scratch buffer it's decoded into, False by default. The EXIF "
+          "metadata is only returned in reported_metadata if requested by "
+          "the flags (and never for JPEG, whose decoder doesn't report it).")
+      .def_readwrite(
+          "compute", &wuffs_aux_wrap::ImageDecoderConfig::compute,
+          "list: list of ImageStatistic computed in a single pass over the "
+          "output pixels (i.e. after applying apply_exif_orientation and "
+          "crop) right after decoding, returned in "
+          "ImageDecodingResult.statistics, empty by default. Only the "
+          "PixelFormat.BGR, RGB, BGRA_*, RGBA_*, BGRX, RGBX, Y and YA_* "
+          "pixel formats are supported, decoding fails with "
+          "ImageDecoderError.UnsupportedStatisticsPixelFormat otherwise.")
+      .def_readwrite(
+          "return_pixbuf", &wuffs_aux_wrap::ImageDecoderConfig::return_pixbuf,
+          "bool: if False, ImageDecodingResult.pixbuf is empty (pixcfg is "
+          "still set), e.g. to only compute statistics, True by default. The "
+          "pixels are then decoded into a scratch buffer reused by the "
+          "following decodes.");
 
   py::class_<wuffs_aux_wrap::ImageDecoderError>(aux_m, "ImageDecoderError")
       .def_readonly_static(
@@ -311,7 +681,16 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
           &wuffs_aux_wrap::ImageDecoderError::UnsupportedPixelFormat)
       .def_readonly_static(
           "FailedToOpenFile",
-          &wuffs_aux_wrap::ImageDecoderError::FailedToOpenFile);
+          &wuffs_aux_wrap::ImageDecoderError::FailedToOpenFile)
+      .def_readonly_static(
+          "FailedToReadFile",
+          &wuffs_aux_wrap::ImageDecoderError::FailedToReadFile)
+      .def_readonly_static(
+          "CropOutOfBounds",
+          &wuffs_aux_wrap::ImageDecoderError::CropOutOfBounds)
+      .def_readonly_static(
+          "UnsupportedStatisticsPixelFormat",
+          &wuffs_aux_wrap::ImageDecoderError::UnsupportedStatisticsPixelFormat);
 
   py::class_<wuffs_aux_wrap::ImageDecodingResult>(
       aux_m, "ImageDecodingResult",
@@ -332,9 +711,10 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
             const auto height = self.pixcfg.height();
             const auto width = self.pixcfg.width();
 
-            if (width == 0 || height == 0) {
+            if (width == 0 || height == 0 || self.pixbuf.empty()) {
               return {};
             }
+            const auto start = wuffs_aux_wrap::Clock::now();
 
             constexpr size_t kNumDimensions = 3;
             const auto channels = self.pixcfg.pixbuf_len() / (width * height);
@@ -343,10 +723,17 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
             const std::array<size_t, kNumDimensions> strides = {
                 width * channels, channels, 1};
 
-            return pybind11::array_t<uint8_t>(pybind11::buffer_info(
+            pybind11::array_t<uint8_t> pixbuf(pybind11::buffer_info(
                 self.pixbuf.data(), sizeof(uint8_t),
                 pybind11::format_descriptor<uint8_t>::value, kNumDimensions,
                 shape, strides));
+            if (!self.stats.phases.empty()) {
+              self.stats.SetPhase(
+                  "python_conversion",
+                  wuffs_aux_wrap::SecondsBetween(
+                      start, wuffs_aux_wrap::Clock::now()));
+            }
+            return pixbuf;
           },
           "np.array: decoded pixel buffer (uint8 Numpy array of [H, "
           "W, C] shape).")
@@ -360,7 +747,32 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
       .def_readonly("error_message",
                     &wuffs_aux_wrap::ImageDecodingResult::error_message,
                     "str: error message, empty on success, one of "
-                    "ImageDecoderError on error.");
+                    "ImageDecoderError on error.")
+      .def_property_readonly(
+          "stats",
+          [](const wuffs_aux_wrap::ImageDecodingResult& self) {
+            return StatsToPython(self.stats);
+          },
+          "dict: None unless ImageDecoderConfig.collect_stats is set, "
+          "otherwise a dict with the \"phases\" dict mapping the phase names "
+          "to their durations in seconds, in order (\"sniff\", "
+          "\"select_decoder\", \"header\", \"metadata\", \"alloc_pixbuf\", "
+          "\"pixels\", \"statistics\", a failed decode only reports the phases "
+          "it started, \"python_conversion\" is added once pixbuf is "
+          "accessed), the "
+          "\"input_bytes\" read and the \"output_bytes\" of the pixel "
+          "buffer.")
+      .def_property_readonly(
+          "statistics",
+          [](const wuffs_aux_wrap::ImageDecodingResult& self) {
+            return StatisticsToPython(self.statistics);
+          },
+          "dict: None unless ImageDecoderConfig.compute is set, otherwise a "
+          "dict holding the computed statistics: \"luma_histogram\" (uint64 "
+          "Numpy array of 256 counts), \"mean\" and \"std\" (lists of "
+          "floats), \"min\" and \"max\" (lists of ints), with one value per "
+          "channel in the pixel format order, \"dhash\" and \"phash\" "
+          "(ints).");
 
   py::class_<wuffs_aux_wrap::ImageDecoder>(aux_m, "ImageDecoder",
                                            "Image decoder class.")
@@ -394,8 +806,29 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
           "Args:"
           "\n path_to_file (str): path to an image file."
           "\nReturns:"
+          "\n ImageDecodingResult: image decoding result.")
+      .def(
+          "decode",
+          [](wuffs_aux_wrap::ImageDecoder& image_decoder,
+             const py::object& file) -> wuffs_aux_wrap::ImageDecodingResult {
+            std::unique_ptr<wuffs_aux_wrap::PythonFileInput> input =
+                MakePythonFileInput(
+                    file, wuffs_aux_wrap::ImageDecoderError::FailedToReadFile);
+            pybind11::gil_scoped_release release_gil;
+            return image_decoder.Decode(
+                *input, [&input]() { return input->bytes_read(); });
+          },
+          "Decodes image using given binary file-like object (e.g. an open "
+          "file, a socket.makefile(\"rb\") stream, a tarfile or zipfile "
+          "member or an HTTP response). It's read in chunks with readinto "
+          "(or read), the GIL being only held around the reads.\n\n"
+          "Args:"
+          "\n file: a binary file-like object."
+          "\nReturns:"
           "\n ImageDecodingResult: image decoding result.");
+#endif  // defined(PYWUFFS_CODEC_ANY_IMAGE)
 
+#if defined(PYWUFFS_CODEC_JSON)
   /*
    * Aux Wuffs API (DecodeJson)
    */
@@ -430,6 +863,14 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
       // clang-format on
       ;
 
+  py::enum_<wuffs_aux_wrap::JsonColumnType>(
+      m, "JsonColumnType", "Column types for JsonDecoder.decode_columnar.")
+      .value("BOOL", wuffs_aux_wrap::JsonColumnType::BOOL)
+      .value("INT64", wuffs_aux_wrap::JsonColumnType::INT64)
+      .value("FLOAT64", wuffs_aux_wrap::JsonColumnType::FLOAT64)
+      .value("STRING", wuffs_aux_wrap::JsonColumnType::STRING)
+      .value("OBJECT", wuffs_aux_wrap::JsonColumnType::OBJECT);
+
   py::class_<wuffs_aux_wrap::JsonDecoderConfig>(aux_m, "JsonDecoderConfig",
                                                 "JSON decoder configuration.")
       .def(py::init<>())
@@ -437,7 +878,40 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
                      "list: list of JsonDecoderQuirks, empty by default.")
       .def_readwrite("json_pointer",
                      &wuffs_aux_wrap::JsonDecoderConfig::json_pointer,
-                     "str: JSON pointer.");
+                     "str: JSON pointer.")
+      .def_readwrite(
+          "json_pointers", &wuffs_aux_wrap::JsonDecoderConfig::json_pointers,
+          "list: list of JSON pointers to extract in a single pass, empty by "
+          "default. If not empty, the parsed value is a dict mapping the "
+          "pointers to the values found (pointers which don't match anything "
+          "are absent). A \"*\" reference token matches any array element, "
+          "so pointers containing it map to the list of all the matching "
+          "values, e.g. \"/items/*/id\". Python objects are only created for "
+          "the extracted values; please note that the duplicate map keys check "
+          "is skipped for the rest of the document. Applied on top of "
+          "json_pointer, if both are set.")
+      .def_readwrite(
+          "numeric_array_max_ndim",
+          &wuffs_aux_wrap::JsonDecoderConfig::numeric_array_max_ndim,
+          "int: if non-zero, arrays consisting only of numbers are decoded "
+          "into NumPy arrays (int64 if all the numbers are integers, float64 "
+          "otherwise) instead of lists. Nested arrays of equally shaped "
+          "numeric arrays become multidimensional NumPy arrays up to this "
+          "number of dimensions. Mixed and empty arrays stay lists. 0 by "
+          "default.")
+      .def_readwrite(
+          "compression", &wuffs_aux_wrap::JsonDecoderConfig::compression,
+          "InputCompression: compression of the input (e.g. .json.gz files), "
+          "default is InputCompression.NONE. The input is decompressed on the "
+          "fly, without holding the whole decompressed document, and the "
+          "cursor positions refer to the decompressed data. Applied by "
+          "decode, decode_many, validate, decode_columnar, iter_records and "
+          "iterparse (which decompress the whole stream before splitting it "
+          "into records or events).")
+      .def_readwrite(
+          "collect_stats", &wuffs_aux_wrap::JsonDecoderConfig::collect_stats,
+          "bool: if True, JsonDecodingResult.stats holds the timing "
+          "breakdown of the decode, False by default.");
 
   py::class_<wuffs_aux_wrap::JsonDecoderError>(aux_m, "JsonDecoderError")
   // clang-format off
@@ -449,6 +923,9 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
       JDEE(NonContainerStackEntry)
       JDEE(BadDepth)
       JDEE(FailedToOpenFile)
+      JDEE(FailedToReadFile)
+      JDEE(NonRecordArray)
+      JDEE(BadColumnType)
       JDEE(BadC0ControlCode)
       JDEE(BadUtf8)
       JDEE(BadBackslashEscape)
@@ -476,6 +953,29 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
       .def_readonly("error_message",
                     &wuffs_aux_wrap::JsonDecodingResult::error_message,
                     "str: error message, empty on success, one of "
+                    "JsonDecoderError on error.")
+      .def_property_readonly(
+          "stats",
+          [](const wuffs_aux_wrap::JsonDecodingResult& self) {
+            return StatsToPython(self.stats);
+          },
+          "dict: None unless JsonDecoderConfig.collect_stats is set, "
+          "otherwise a dict with the \"phases\" dict mapping the phase names "
+          "to their durations in seconds (\"decode\", which interleaves the "
+          "parsing and the Python objects creation, or \"parse\" and "
+          "\"python_conversion\" for decode_many and decode_parallel), the "
+          "\"input_bytes\" consumed and \"output_bytes\" (always 0).");
+
+  py::class_<wuffs_aux_wrap::JsonValidationResult>(
+      aux_m, "JsonValidationResult",
+      "JSON validation result. The error_message is empty if the JSON is "
+      "valid.")
+      .def_readonly("cursor_position",
+                    &wuffs_aux_wrap::JsonValidationResult::cursor_position,
+                    "int: cursor position.")
+      .def_readonly("error_message",
+                    &wuffs_aux_wrap::JsonValidationResult::error_message,
+                    "str: error message, empty on success, one of "
                     "JsonDecoderError on error.");
 
   py::class_<wuffs_aux_wrap::JsonDecoder>(aux_m, "JsonDecoder",
@@ -508,5 +1008,759 @@ py::enum_<wuffs_aux_wrap::PixelFormat>(
           "Args:"
           "\n path_to_file (str): path to a JSON file."
           "\nReturns:"
-          "\n JsonDecodingResult: JSON decoding result.");
+          "\n JsonDecodingResult: JSON decoding result.")
+      .def(
+          "decode",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder,
+             const py::object& file) -> wuffs_aux_wrap::JsonDecodingResult {
+            return json_decoder.Decode(*MakePythonFileInput(
+                file, wuffs_aux_wrap::JsonDecoderError::FailedToReadFile));
+          },
+          "Decodes JSON using given binary file-like object (e.g. an open "
+          "file, a socket.makefile(\"rb\") stream, a tarfile or zipfile "
+          "member or an HTTP response), read in chunks with readinto (or "
+          "read).\n\n"
+          "Args:"
+          "\n file: a binary file-like object."
+          "\nReturns:"
+          "\n JsonDecodingResult: JSON decoding result.")
+      .def(
+          "validate",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder,
+             const py::bytes& data) -> wuffs_aux_wrap::JsonValidationResult {
+            py::buffer_info data_view(py::buffer(data).request());
+            return json_decoder.Validate(
+                reinterpret_cast<uint8_t*>(data_view.ptr), data_view.size);
+          },
+          "Validates JSON using given byte buffer without creating Python "
+          "objects, with the GIL released. The quirks are applied the same way "
+          "as in decode (e.g. data after the top-level value is only rejected "
+          "with EXPECT_TRAILING_NEW_LINE_OR_EOF), duplicate map keys are "
+          "errors, the JSON pointers are not applied.\n\n"
+          "Args:"
+          "\n data (bytes): a byte buffer holding JSON string."
+          "\nReturns:"
+          "\n JsonValidationResult: JSON validation result.")
+      .def(
+          "validate",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder,
+             const std::string& path_to_file)
+              -> wuffs_aux_wrap::JsonValidationResult {
+            return json_decoder.Validate(path_to_file);
+          },
+          "Validates JSON using given file path. See the byte buffer overload "
+          "for details.\n\n"
+          "Args:"
+          "\n path_to_file (str): path to a JSON file."
+          "\nReturns:"
+          "\n JsonValidationResult: JSON validation result.")
+      .def(
+          "validate",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder,
+             const py::object& file) -> wuffs_aux_wrap::JsonValidationResult {
+            return json_decoder.Validate(*MakePythonFileInput(
+                file, wuffs_aux_wrap::JsonDecoderError::FailedToReadFile));
+          },
+          "Validates JSON using given binary file-like object, read in chunks "
+          "with readinto (or read), the GIL being only held around the reads. "
+          "See the byte buffer overload for details.\n\n"
+          "Args:"
+          "\n file: a binary file-like object."
+          "\nReturns:"
+          "\n JsonValidationResult: JSON validation result.")
+      .def(
+          "decode_columnar",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder, const py::bytes& data,
+             const py::dict& schema) -> wuffs_aux_wrap::JsonDecodingResult {
+            py::buffer_info data_view(py::buffer(data).request());
+            return json_decoder.DecodeColumnar(
+                reinterpret_cast<uint8_t*>(data_view.ptr), data_view.size,
+                ConvertColumnarSchema(schema));
+          },
+          py::arg("data"), py::arg("schema") = py::dict(),
+          "Decodes an array of JSON objects (records) into columns, one per "
+          "field, without creating Python objects per record. The parsed "
+          "value is a dict mapping field names to dicts with the following "
+          "keys:"
+          "\n - \"type\": JsonColumnType of the column."
+          "\n - \"data\": NumPy array of bool, int64 or float64 values, of "
+          "concatenated UTF-8 bytes for STRING columns, or of objects for "
+          "OBJECT columns."
+          "\n - \"offsets\": for STRING columns only, int64 NumPy array of "
+          "rows + 1 offsets, the i-th string being "
+          "data[offsets[i]:offsets[i + 1]]."
+          "\n - \"mask\": bool NumPy array, True for null and missing values "
+          "(which hold 0, NaN or empty strings in data)."
+          "\nThe buffers are handed over without copying, so that pandas or "
+          "Arrow arrays can wrap them. Without a schema, the columns follow "
+          "the order in which the fields first appear and their types are "
+          "inferred: integers are promoted to FLOAT64 when mixed with "
+          "floating point numbers, other mixes and nested values make OBJECT "
+          "columns. The json_pointer option selects the array, "
+          "json_pointers is not applied.\n\n"
+          "Args:"
+          "\n data (bytes): a byte buffer holding JSON string."
+          "\n schema (dict): optional mapping of field names to "
+          "JsonColumnType. If not empty, only these fields are decoded, in "
+          "this order, and a value not matching its column type (integers "
+          "match FLOAT64, anything matches OBJECT) is an error."
+          "\nReturns:"
+          "\n JsonDecodingResult: JSON decoding result.")
+      .def(
+          "decode_columnar",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder,
+             const std::string& path_to_file,
+             const py::dict& schema) -> wuffs_aux_wrap::JsonDecodingResult {
+            return json_decoder.DecodeColumnar(path_to_file,
+                                               ConvertColumnarSchema(schema));
+          },
+          py::arg("path_to_file"), py::arg("schema") = py::dict(),
+          "Decodes an array of JSON objects (records) into columns using given "
+          "file path. See the byte buffer overload for details.\n\n"
+          "Args:"
+          "\n path_to_file (str): path to a JSON file."
+          "\n schema (dict): optional mapping of field names to "
+          "JsonColumnType."
+          "\nReturns:"
+          "\n JsonDecodingResult: JSON decoding result.")
+      .def(
+          "decode_many",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder,
+             const std::vector<py::bytes>& data, size_t num_threads) {
+            std::vector<py::buffer_info> data_views;
+            std::vector<std::pair<const uint8_t*, size_t>> buffers;
+            data_views.reserve(data.size());
+            buffers.reserve(data.size());
+            for (const auto& d : data) {
+              data_views.emplace_back(py::buffer(d).request());
+              buffers.emplace_back(
+                  reinterpret_cast<uint8_t*>(data_views.back().ptr),
+                  data_views.back().size);
+            }
+            py::list results;
+            for (auto& result : json_decoder.DecodeMany(buffers, num_threads)) {
+              results.append(
+                  py::cast(std::move(result), py::return_value_policy::move));
+            }
+            return results;
+          },
+          py::arg("data"), py::arg("num_threads") = 0,
+          "Decodes multiple JSON documents. Tokenizing and number/string "
+          "parsing run on native threads with the GIL released, Python "
+          "objects are created on the calling thread afterwards.\n\n"
+          "Args:"
+          "\n data (list): a list of byte buffers holding JSON strings."
+          "\n num_threads (int): maximum number of threads to use, 0 (the "
+          "default) stands for the number of hardware threads."
+          "\nReturns:"
+          "\n list: JsonDecodingResult for each input buffer, in the input "
+          "order.")
+      .def(
+          "decode_parallel",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder, const py::bytes& data,
+             size_t num_threads) -> wuffs_aux_wrap::JsonDecodingResult {
+            py::buffer_info data_view(py::buffer(data).request());
+            return json_decoder.DecodeParallel(
+                reinterpret_cast<uint8_t*>(data_view.ptr), data_view.size,
+                num_threads);
+          },
+          py::arg("data"), py::arg("num_threads") = 0,
+          "Decodes a single large JSON document whose top-level value is an "
+          "array or an object. The top-level elements (members) are split "
+          "into chunks, which are tokenized and parsed on native threads "
+          "with the GIL released, then Python objects are created on the "
+          "calling thread and joined in order. The result is the same as the "
+          "one of decode, which is used instead if quirks, json_pointer, "
+          "json_pointers, numeric_array_max_ndim or compression are set, if "
+          "the document is too small to be split, or if it's invalid (so "
+          "that the error_message and cursor_position are exact).\n\n"
+          "Args:"
+          "\n data (bytes): a byte buffer holding JSON string."
+          "\n num_threads (int): maximum number of threads to use, 0 (the "
+          "default) stands for the number of hardware threads."
+          "\nReturns:"
+          "\n JsonDecodingResult: JSON decoding result.")
+      .def(
+          "iter_records",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder, const py::bytes& data,
+             size_t batch_size) -> wuffs_aux_wrap::JsonRecordReader {
+            py::buffer_info data_view(py::buffer(data).request());
+            return wuffs_aux_wrap::JsonRecordReader(
+                json_decoder, reinterpret_cast<uint8_t*>(data_view.ptr),
+                data_view.size, batch_size);
+          },
+          py::arg("data"), py::arg("batch_size") = 0, py::keep_alive<0, 1>(),
+          py::keep_alive<0, 2>(),
+          "Iterates over JSON records (JSON Lines / NDJSON or "
+          "whitespace-separated concatenated JSON) in given byte buffer. A "
+          "record must not span multiple lines, but a line may hold several "
+          "records. A malformed record doesn't abort the iteration: its "
+          "result holds the error message and the cursor position (an offset "
+          "in the input) and the rest of its line is skipped. With a JSON "
+          "pointer configured, the pointer is applied to each record and the "
+          "rest of each line is skipped.\n\n"
+          "Args:"
+          "\n data (bytes): a byte buffer holding JSON records."
+          "\n batch_size (int): if non-zero, records are yielded as lists of "
+          "up to batch_size results."
+          "\nReturns:"
+          "\n JsonRecordReader: iterator over JsonDecodingResult objects "
+          "(or lists of them).")
+      .def(
+          "iter_records",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder,
+             const std::string& path_to_file,
+             size_t batch_size) -> wuffs_aux_wrap::JsonRecordReader {
+            return wuffs_aux_wrap::JsonRecordReader(json_decoder, path_to_file,
+                                                    batch_size);
+          },
+          py::arg("path_to_file"), py::arg("batch_size") = 0,
+          py::keep_alive<0, 1>(),
+          "Iterates over JSON records in given file, reading it in fixed-size "
+          "chunks. See the byte buffer overload for details.\n\n"
+          "Args:"
+          "\n path_to_file (str): path to a JSON Lines file."
+          "\n batch_size (int): if non-zero, records are yielded as lists of "
+          "up to batch_size results."
+          "\nReturns:"
+          "\n JsonRecordReader: iterator over JsonDecodingResult objects "
+          "(or lists of them).")
+      .def(
+          "iter_records",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder, const py::object& file,
+             size_t batch_size) -> wuffs_aux_wrap::JsonRecordReader {
+            return wuffs_aux_wrap::JsonRecordReader(
+                json_decoder,
+                MakePythonFileInput(
+                    file, wuffs_aux_wrap::JsonDecoderError::FailedToReadFile),
+                batch_size);
+          },
+          py::arg("file"), py::arg("batch_size") = 0, py::keep_alive<0, 1>(),
+          "Iterates over JSON records in given binary file-like object (e.g. "
+          "a socket.makefile(\"rb\") stream, a tarfile or zipfile member or "
+          "an HTTP response), reading it in fixed-size chunks. See the byte "
+          "buffer overload for details.\n\n"
+          "Args:"
+          "\n file: a binary file-like object."
+          "\n batch_size (int): if non-zero, records are yielded as lists of "
+          "up to batch_size results."
+          "\nReturns:"
+          "\n JsonRecordReader: iterator over JsonDecodingResult objects "
+          "(or lists of them).")
+      .def(
+          "iterparse",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder, const py::bytes& data,
+             const py::object& prefix_filter) {
+            py::buffer_info data_view(py::buffer(data).request());
+            return new wuffs_aux_wrap::JsonEventParser(
+                json_decoder, reinterpret_cast<uint8_t*>(data_view.ptr),
+                data_view.size,
+                prefix_filter.is_none() ? std::string()
+                                        : prefix_filter.cast<std::string>());
+          },
+          py::arg("data"), py::arg("prefix_filter") = py::none(),
+          py::keep_alive<0, 2>(),
+          "Parses JSON from given byte buffer incrementally, in the style of "
+          "ijson.parse. Yields (prefix, event, value) tuples, where the event "
+          "is one of \"start_map\", \"map_key\", \"end_map\", "
+          "\"start_array\", \"end_array\", \"null\", \"boolean\", "
+          "\"number\" and \"string\", and the prefix is the dot-separated "
+          "path of map keys and \"item\" for array elements. No tree is "
+          "built, so the memory usage doesn't depend on the document size. "
+          "The quirks are applied, the JSON pointers are not. Parsing errors "
+          "stop the iteration, so please check the error_message attribute of "
+          "the returned JsonEventParser afterwards.\n\n"
+          "Args:"
+          "\n data (bytes): a byte buffer holding JSON string."
+          "\n prefix_filter (str): if set, only the events with this prefix "
+          "or prefixes starting with it followed by a dot are yielded, no "
+          "Python objects are created for the others."
+          "\nReturns:"
+          "\n JsonEventParser: iterator over (prefix, event, value) tuples.")
+      .def(
+          "iterparse",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder,
+             const std::string& path_to_file,
+             const py::object& prefix_filter) {
+            return new wuffs_aux_wrap::JsonEventParser(
+                json_decoder, path_to_file,
+                prefix_filter.is_none() ? std::string()
+                                        : prefix_filter.cast<std::string>());
+          },
+          py::arg("path_to_file"), py::arg("prefix_filter") = py::none(),
+          "Parses JSON from given file incrementally, reading it in "
+          "fixed-size chunks. See the byte buffer overload for details.\n\n"
+          "Args:"
+          "\n path_to_file (str): path to a JSON file."
+          "\n prefix_filter (str): if set, only the events with this prefix "
+          "or prefixes starting with it followed by a dot are yielded."
+          "\nReturns:"
+          "\n JsonEventParser: iterator over (prefix, event, value) tuples.")
+      .def(
+          "iterparse",
+          [](wuffs_aux_wrap::JsonDecoder& json_decoder, const py::object& file,
+             const py::object& prefix_filter) {
+            return new wuffs_aux_wrap::JsonEventParser(
+                json_decoder,
+                MakePythonFileInput(
+                    file, wuffs_aux_wrap::JsonDecoderError::FailedToReadFile),
+                prefix_filter.is_none() ? std::string()
+                                        : prefix_filter.cast<std::string>());
+          },
+          py::arg("file"), py::arg("prefix_filter") = py::none(),
+          "Parses JSON from given binary file-like object incrementally, "
+          "reading it in fixed-size chunks with the GIL released between the "
+          "reads. See the byte buffer overload for details.\n\n"
+          "Args:"
+          "\n file: a binary file-like object."
+          "\n prefix_filter (str): if set, only the events with this prefix "
+          "or prefixes starting with it followed by a dot are yielded."
+          "\nReturns:"
+          "\n JsonEventParser: iterator over (prefix, event, value) tuples.");
+
+  py::class_<wuffs_aux_wrap::JsonRecordReader>(
+      aux_m, "JsonRecordReader",
+      "Iterator over JSON records returned by JsonDecoder.iter_records. Please "
+      "note that it uses the decoder it was created with.")
+      .def("__iter__", [](py::object self) { return self; })
+      .def("__next__",
+           [](wuffs_aux_wrap::JsonRecordReader& reader) -> py::object {
+             if (reader.batch_size() == 0) {
+               wuffs_aux_wrap::JsonDecodingResult result;
+               if (!reader.Next(result)) {
+                 throw py::stop_iteration();
+               }
+               return py::cast(std::move(result),
+                               py::return_value_policy::move);
+             }
+             py::list batch;
+             while (batch.size() < reader.batch_size()) {
+               wuffs_aux_wrap::JsonDecodingResult result;
+               if (!reader.Next(result)) {
+                 break;
+               }
+               batch.append(
+                   py::cast(std::move(result), py::return_value_policy::move));
+             }
+             if (batch.size() == 0) {
+               throw py::stop_iteration();
+             }
+             return std::move(batch);
+           });
+
+  py::class_<wuffs_aux_wrap::JsonEventParser>(
+      aux_m, "JsonEventParser",
+      "Iterator over (prefix, event, value) tuples returned by "
+      "JsonDecoder.iterparse.")
+      .def("__iter__", [](py::object self) { return self; })
+      .def("__next__",
+           [](wuffs_aux_wrap::JsonEventParser& parser) -> py::object {
+             py::object event = parser.Next();
+             if (!event) {
+               throw py::stop_iteration();
+             }
+             return event;
+           })
+      .def_property_readonly(
+          "error_message", &wuffs_aux_wrap::JsonEventParser::error_message,
+          "str: error message, empty unless the iteration stopped on error, "
+          "one of JsonDecoderError on error.")
+      .def_property_readonly(
+          "cursor_position", &wuffs_aux_wrap::JsonEventParser::cursor_position,
+          "int: cursor position.");
+#endif  // defined(PYWUFFS_CODEC_JSON)
+
+#if defined(PYWUFFS_CODEC_CBOR)
+  /*
+   * Aux Wuffs API (DecodeCbor)
+   */
+
+  py::class_<wuffs_aux_wrap::CborTag>(
+      aux_m, "CborTag",
+      "CBOR tagged data item, e.g. CborTag(1, 1700000000) for an epoch-based "
+      "date/time. RFC 8746 typed arrays are decoded into NumPy arrays "
+      "instead, unless disabled.")
+      .def(py::init([](uint64_t tag, py::object value) {
+             return wuffs_aux_wrap::CborTag{tag, std::move(value)};
+           }),
+           py::arg("tag"), py::arg("value"))
+      .def_readonly("tag", &wuffs_aux_wrap::CborTag::tag, "int: tag number.")
+      .def_readonly("value", &wuffs_aux_wrap::CborTag::value,
+                    "obj: tagged value.")
+      .def("__eq__",
+           [](const wuffs_aux_wrap::CborTag& self, const py::object& other) {
+             if (!py::isinstance<wuffs_aux_wrap::CborTag>(other)) {
+               return false;
+             }
+             const auto& other_tag = other.cast<wuffs_aux_wrap::CborTag&>();
+             return self.tag == other_tag.tag &&
+                    self.value.equal(other_tag.value);
+           })
+      .def("__hash__",
+           [](const wuffs_aux_wrap::CborTag& self) {
+             return py::hash(py::make_tuple(self.tag, self.value));
+           })
+      .def("__repr__", [](const wuffs_aux_wrap::CborTag& self) {
+        return "CborTag(" + std::to_string(self.tag) + ", " +
+               py::repr(self.value).cast<std::string>() + ")";
+      });
+
+  py::class_<wuffs_aux_wrap::CborSimpleValue>(
+      aux_m, "CborSimpleValue",
+      "CBOR simple value other than false, true and null, e.g. "
+      "CborSimpleValue(23) for undefined.")
+      .def(py::init([](uint8_t value) {
+             return wuffs_aux_wrap::CborSimpleValue{value};
+           }),
+           py::arg("value"))
+      .def_readonly("value", &wuffs_aux_wrap::CborSimpleValue::value,
+                    "int: simple value number.")
+      .def("__eq__",
+           [](const wuffs_aux_wrap::CborSimpleValue& self,
+              const py::object& other) {
+             return py::isinstance<wuffs_aux_wrap::CborSimpleValue>(other) &&
+                    self.value ==
+                        other.cast<wuffs_aux_wrap::CborSimpleValue&>().value;
+           })
+      .def("__hash__",
+           [](const wuffs_aux_wrap::CborSimpleValue& self) {
+             return py::hash(py::int_(self.value));
+           })
+      .def("__repr__", [](const wuffs_aux_wrap::CborSimpleValue& self) {
+        return "CborSimpleValue(" + std::to_string(self.value) + ")";
+      });
+
+  py::class_<wuffs_aux_wrap::CborDecoderConfig>(aux_m, "CborDecoderConfig",
+                                                "CBOR decoder configuration.")
+      .def(py::init<>())
+      .def_readwrite(
+          "byte_string_views",
+          &wuffs_aux_wrap::CborDecoderConfig::byte_string_views,
+          "bool: if True (the default), byte strings are decoded into "
+          "memoryviews wrapping the decoded buffers without copying them, "
+          "otherwise into bytes. Byte string map keys are always bytes.")
+      .def_readwrite(
+          "typed_arrays", &wuffs_aux_wrap::CborDecoderConfig::typed_arrays,
+          "bool: if True (the default), RFC 8746 typed arrays (tags 64 to 87 "
+          "except for 76, 83 and 87) are decoded into 1D NumPy arrays "
+          "wrapping the decoded buffers without copying them, otherwise into "
+          "CborTag objects.");
+
+  py::class_<wuffs_aux_wrap::CborDecoderError>(aux_m, "CborDecoderError")
+  // clang-format off
+#define CDEE(error) .def_readonly_static(#error, &wuffs_aux_wrap::CborDecoderError::error)
+      CDEE(DuplicateMapKey)
+      CDEE(UnhashableMapKey)
+      CDEE(BadDepth)
+      CDEE(FailedToOpenFile)
+      CDEE(BadInput)
+      CDEE(UnsupportedRecursionDepth)
+#undef CDEE
+      // clang-format on
+      ;
+
+  py::class_<wuffs_aux_wrap::CborDecodingResult>(
+      aux_m, "CborDecodingResult",
+      "CBOR decoding result. The fields depend on whether decoding "
+      "succeeded:\n"
+      " - On total success, the error_message is empty and parsed is not "
+      "empty.\n"
+      " - On failure, the error_message is non-empty and parsed is empty.")
+      .def_readonly("cursor_position",
+                    &wuffs_aux_wrap::CborDecodingResult::cursor_position,
+                    "int: cursor position.")
+      .def_readonly("parsed", &wuffs_aux_wrap::CborDecodingResult::parsed,
+                    "obj: parsed CBOR data.")
+      .def_readonly("error_message",
+                    &wuffs_aux_wrap::CborDecodingResult::error_message,
+                    "str: error message, empty on success, one of "
+                    "CborDecoderError on error.");
+
+  py::class_<wuffs_aux_wrap::CborDecoder>(aux_m, "CborDecoder",
+                                          "CBOR decoder class.")
+      .def(py::init<const wuffs_aux_wrap::CborDecoderConfig&>(),
+           "Sole constructor. Please note that the class is not thread-safe."
+           "\n\n"
+           "Args:"
+           "\n config (CborDecoderConfig): CBOR decoder config.")
+      .def(
+          "decode",
+          [](wuffs_aux_wrap::CborDecoder& cbor_decoder,
+             const py::bytes& data) -> wuffs_aux_wrap::CborDecodingResult {
+            py::buffer_info data_view(py::buffer(data).request());
+            return cbor_decoder.Decode(
+                reinterpret_cast<uint8_t*>(data_view.ptr), data_view.size);
+          },
+          "Decodes CBOR using given byte buffer. Maps may have any hashable "
+          "keys, integers beyond the int64 range are Python ints, undefined "
+          "is CborSimpleValue(23).\n\n"
+          "Args:"
+          "\n data (bytes): a byte buffer holding CBOR data."
+          "\nReturns:"
+          "\n CborDecodingResult: CBOR decoding result.")
+      .def(
+          "decode",
+          [](wuffs_aux_wrap::CborDecoder& cbor_decoder,
+             const std::string& path_to_file)
+              -> wuffs_aux_wrap::CborDecodingResult {
+            return cbor_decoder.Decode(path_to_file);
+          },
+          "Decodes CBOR using given file path.\n\n"
+          "Args:"
+          "\n path_to_file (str): path to a CBOR file."
+          "\nReturns:"
+          "\n CborDecodingResult: CBOR decoding result.");
+#endif  // defined(PYWUFFS_CODEC_CBOR)
+
+  /*
+   * Decompression (wuffs_base__io_transformer)
+   */
+
+  py::enum_<wuffs_aux_wrap::InputCompression>(
+      m, "InputCompression",
+      "Compression of the JsonDecoder and ImageDecoder input.")
+      .value("NONE", wuffs_aux_wrap::InputCompression::NONE,
+             "Uncompressed input.")
+  // clang-format off
+#if defined(PYWUFFS_CODEC_DEFLATE)
+      .value("DEFLATE", wuffs_aux_wrap::InputCompression::DEFLATE,
+             "Raw Deflate (RFC 1951).")
+#endif
+#if defined(PYWUFFS_CODEC_GZIP)
+      .value("GZIP", wuffs_aux_wrap::InputCompression::GZIP,
+             "Gzip (RFC 1952), a single member.")
+#endif
+#if defined(PYWUFFS_CODEC_ZLIB)
+      .value("ZLIB", wuffs_aux_wrap::InputCompression::ZLIB,
+             "Zlib (RFC 1950).")
+#endif
+#if defined(PYWUFFS_CODEC_BZIP2)
+      .value("BZIP2", wuffs_aux_wrap::InputCompression::BZIP2, "Bzip2.")
+#endif
+#if defined(PYWUFFS_CODEC_LZMA)
+      .value("LZMA", wuffs_aux_wrap::InputCompression::LZMA,
+             "LZMA (the .lzma format with a 13-byte header).")
+#endif
+#if defined(PYWUFFS_CODEC_XZ)
+      .value("XZ", wuffs_aux_wrap::InputCompression::XZ, "Xz.")
+#endif
+      // clang-format on
+      ;
+
+#if defined(PYWUFFS_CODEC_ANY_COMPRESSION)
+  py::enum_<wuffs_aux_wrap::DecompressorType>(m, "DecompressorType")
+  // clang-format off
+#if defined(PYWUFFS_CODEC_DEFLATE)
+      .value("DEFLATE", wuffs_aux_wrap::DecompressorType::DEFLATE,
+             "Raw Deflate (RFC 1951).")
+#endif
+#if defined(PYWUFFS_CODEC_GZIP)
+      .value("GZIP", wuffs_aux_wrap::DecompressorType::GZIP,
+             "Gzip (RFC 1952), a single member.")
+#endif
+#if defined(PYWUFFS_CODEC_ZLIB)
+      .value("ZLIB", wuffs_aux_wrap::DecompressorType::ZLIB,
+             "Zlib (RFC 1950).")
+#endif
+#if defined(PYWUFFS_CODEC_BZIP2)
+      .value("BZIP2", wuffs_aux_wrap::DecompressorType::BZIP2, "Bzip2.")
+#endif
+#if defined(PYWUFFS_CODEC_LZMA)
+      .value("LZMA", wuffs_aux_wrap::DecompressorType::LZMA,
+             "LZMA (the .lzma format with a 13-byte header).")
+#endif
+#if defined(PYWUFFS_CODEC_XZ)
+      .value("XZ", wuffs_aux_wrap::DecompressorType::XZ, "Xz.")
+#endif
+      // clang-format on
+      ;
+
+  py::enum_<wuffs_aux_wrap::DecompressorQuirks>(
+      m, "DecompressorQuirks",
+      "See https://github.com/google/wuffs/blob/main/doc/note/quirks.md.")
+      .value("IGNORE_CHECKSUM",
+             wuffs_aux_wrap::DecompressorQuirks::IGNORE_CHECKSUM,
+             "Favor faster decodes over rejecting invalid checksums.");
+
+  py::class_<wuffs_aux_wrap::DecompressorConfig>(
+      aux_m, "DecompressorConfig", "Decompressor configuration.")
+      .def(py::init<>())
+      .def_readwrite("type", &wuffs_aux_wrap::DecompressorConfig::type,
+                     "DecompressorType: compression format, default is "
+                     "DecompressorType.GZIP.")
+      .def_readwrite("quirks", &wuffs_aux_wrap::DecompressorConfig::quirks,
+                     "dict: dict of DecompressorQuirks:<quirk-value> pairs, "
+                     "empty by default.")
+      .def_readwrite(
+          "max_output_size",
+          &wuffs_aux_wrap::DecompressorConfig::max_output_size,
+          "int: maximum decompressed size of a stream in bytes, exceeding it "
+          "is an error (a guard against decompression bombs). 0 (the "
+          "default) means no limit.");
+
+  py::class_<wuffs_aux_wrap::DecompressorError>(aux_m, "DecompressorError")
+      .def_readonly_static(
+          "MaxOutputSizeExceeded",
+          &wuffs_aux_wrap::DecompressorError::MaxOutputSizeExceeded)
+      .def_readonly_static(
+          "UnexpectedEndOfFile",
+          &wuffs_aux_wrap::DecompressorError::UnexpectedEndOfFile)
+      .def_readonly_static("OutOfMemory",
+                           &wuffs_aux_wrap::DecompressorError::OutOfMemory)
+      .def_readonly_static(
+          "UnsupportedDecompressorType",
+          &wuffs_aux_wrap::DecompressorError::UnsupportedDecompressorType);
+
+  py::class_<wuffs_aux_wrap::DecompressionResult>(
+      aux_m, "DecompressionResult",
+      "Decompression result. On failure, the error_message is non-empty and "
+      "data holds the output decompressed before the error.")
+      .def_property_readonly(
+          "data",
+          [](py::object self) {
+            auto& result = self.cast<wuffs_aux_wrap::DecompressionResult&>();
+            return py::array_t<uint8_t>({result.data.size()}, {1},
+                                        result.data.data(), self);
+          },
+          "np.array: decompressed data (1D uint8 Numpy array sharing memory "
+          "with the result).")
+      .def_readonly("error_message",
+                    &wuffs_aux_wrap::DecompressionResult::error_message,
+                    "str: error message, empty on success, one of "
+                    "DecompressorError or a Wuffs error on error.");
+
+  py::class_<wuffs_aux_wrap::Decompressor>(
+      aux_m, "Decompressor",
+      "Decompressor class. It is not thread-safe: feed and reset mutate the "
+      "state of the fed stream (feed with the GIL released), so an instance "
+      "must not be shared between threads without locking.")
+      .def(py::init<const wuffs_aux_wrap::DecompressorConfig&>(),
+           "Sole constructor. Please note that the class is not thread-safe."
+           "\n\n"
+           "Args:"
+           "\n config (DecompressorConfig): decompressor config.")
+      .def(
+          "decompress",
+          [](wuffs_aux_wrap::Decompressor& decompressor,
+             const py::bytes& data) -> wuffs_aux_wrap::DecompressionResult {
+            py::buffer_info data_view(py::buffer(data).request());
+            return decompressor.Decompress(
+                reinterpret_cast<uint8_t*>(data_view.ptr), data_view.size);
+          },
+          "Decompresses a whole stream using given byte buffer, with the GIL "
+          "released. The data after the end of the stream is ignored.\n\n"
+          "Args:"
+          "\n data (bytes): a byte buffer holding compressed data."
+          "\nReturns:"
+          "\n DecompressionResult: decompression result.")
+      .def(
+          "feed",
+          [](py::object self, const py::bytes& data, bool copy) -> py::object {
+            auto& decompressor = self.cast<wuffs_aux_wrap::Decompressor&>();
+            py::buffer_info data_view(py::buffer(data).request());
+            const auto output = decompressor.Feed(
+                reinterpret_cast<uint8_t*>(data_view.ptr), data_view.size);
+            if (copy) {
+              return py::bytes(reinterpret_cast<const char*>(output.first),
+                               output.second);
+            }
+            // The array points to the internal buffer, kept alive by the
+            // decompressor handle. It's read-only since the output is the
+            // history of the next call.
+            static const uint8_t kNoOutput = 0;
+            py::array_t<uint8_t> array(
+                {output.second}, {1},
+                output.first ? output.first : &kNoOutput, self);
+            array.attr("flags").attr("writeable") = false;
+            return std::move(array);
+          },
+          "Decompresses the next chunk of a stream, with the GIL released. "
+          "The returned array points to an internal buffer, without copying: "
+          "it keeps the decompressor alive, but its contents are only valid "
+          "until the next feed or reset call, so please copy the data (or "
+          "pass copy=True) if it's needed afterwards. Decompression errors "
+          "are sticky: the error_message attribute is set and the following "
+          "calls return empty outputs. The data after the end of the stream "
+          "is ignored.\n\n"
+          "Args:"
+          "\n data (bytes): a chunk of compressed data."
+          "\n copy (bool): return a copy of the output as bytes, default is "
+          "False."
+          "\nReturns:"
+          "\n np.array or bytes: the data decompressed from the chunk "
+          "(read-only 1D uint8 Numpy array, or bytes if copy is True), "
+          "possibly empty.",
+          py::arg("data"), py::arg("copy") = false)
+      .def("reset", &wuffs_aux_wrap::Decompressor::Reset,
+           "Starts a new stream for feed.")
+      .def_property_readonly(
+          "error_message", &wuffs_aux_wrap::Decompressor::error_message,
+          "str: error message of the fed stream, empty unless it failed, one "
+          "of DecompressorError or a Wuffs error on error.")
+      .def_property_readonly(
+          "finished", &wuffs_aux_wrap::Decompressor::finished,
+          "bool: whether the end of the fed stream was reached. If it's "
+          "False after feeding the whole input, the input was truncated.");
+#endif  // defined(PYWUFFS_CODEC_ANY_COMPRESSION)
+
+  /*
+   * Checksums and hashes
+   */
+
+  py::module hash_m = m.def_submodule(
+      "hash",
+      "Checksums and hashes. Every function takes any C-contiguous buffer "
+      "or a list of them, and hashes with the GIL released (except for "
+      "buffers smaller than 2 KiB).");
+
+#if defined(PYWUFFS_CODEC_CRC32)
+  BindHasher<wuffs_aux_wrap::Crc32Hasher>(
+      hash_m, "crc32",
+      "Computes the CRC-32 (IEEE) checksum, as zlib.crc32 does.\n\n"
+      "Args:"
+      "\n data (buffer): any C-contiguous buffer."
+      "\nReturns:"
+      "\n int: checksum.",
+      "Crc32", "Incremental CRC-32 (IEEE) hasher.");
+#endif
+#if defined(PYWUFFS_CODEC_ADLER32)
+  BindHasher<wuffs_aux_wrap::Adler32Hasher>(
+      hash_m, "adler32",
+      "Computes the Adler-32 checksum, as zlib.adler32 does.\n\n"
+      "Args:"
+      "\n data (buffer): any C-contiguous buffer."
+      "\nReturns:"
+      "\n int: checksum.",
+      "Adler32", "Incremental Adler-32 hasher.");
+#endif
+#if defined(PYWUFFS_CODEC_XXHASH32)
+  BindHasher<wuffs_aux_wrap::XxHash32Hasher>(
+      hash_m, "xxhash32",
+      "Computes the XXH32 hash with seed 0.\n\n"
+      "Args:"
+      "\n data (buffer): any C-contiguous buffer."
+      "\nReturns:"
+      "\n int: hash.",
+      "XxHash32", "Incremental XXH32 hasher.");
+#endif
+#if defined(PYWUFFS_CODEC_XXHASH64)
+  BindHasher<wuffs_aux_wrap::XxHash64Hasher>(
+      hash_m, "xxhash64",
+      "Computes the XXH64 hash with seed 0.\n\n"
+      "Args:"
+      "\n data (buffer): any C-contiguous buffer."
+      "\nReturns:"
+      "\n int: hash.",
+      "XxHash64", "Incremental XXH64 hasher.");
+#endif
+#if defined(PYWUFFS_CODEC_SHA256)
+  BindHasher<wuffs_aux_wrap::Sha256Hasher>(
+      hash_m, "sha256",
+      "Computes the SHA-256 digest.\n\n"
+      "Args:"
+      "\n data (buffer): any C-contiguous buffer."
+      "\nReturns:"
+      "\n bytes: 32-byte digest.",
+      "Sha256", "Incremental SHA-256 hasher.");
+#endif
 }
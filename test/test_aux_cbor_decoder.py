@@ -0,0 +1,116 @@
+import struct
+import pytest
+import numpy as np
+
+from pywuffs import *
+from pywuffs.aux import *
+
+# Positive test cases
+
+
+def decode(data, config=None):
+    decoder = CborDecoder(config or CborDecoderConfig())
+    result = decoder.decode(data)
+    assert len(result.error_message) == 0
+    assert result.cursor_position != 0
+    return result.parsed
+
+
+def test_decode_default_config(tmp_path):
+    # {"a": 1, "b": [true, null, -5, 1.5], "c": h'0102'}
+    data = bytes.fromhex("a3616101616284f5f624f93e00616342 0102")
+    parsed = decode(data)
+    assert parsed["a"] == 1
+    assert parsed["b"] == [True, None, -5, 1.5]
+    assert isinstance(parsed["c"], memoryview)
+    assert bytes(parsed["c"]) == b"\x01\x02"
+    file_path = tmp_path / "document.cbor"
+    file_path.write_bytes(data)
+    decoding_result_from_file = CborDecoder(CborDecoderConfig()).decode(
+        str(file_path))
+    assert len(decoding_result_from_file.error_message) == 0
+    assert decoding_result_from_file.parsed["b"] == parsed["b"]
+
+
+def test_decode_byte_strings():
+    # {h'00': h'0102'}
+    data = bytes.fromhex("a1410042 0102")
+    config = CborDecoderConfig()
+    parsed = decode(data, config)
+    assert bytes(parsed[b"\x00"]) == b"\x01\x02"
+    config.byte_string_views = False
+    assert decode(data, config) == {b"\x00": b"\x01\x02"}
+
+
+def test_decode_integers():
+    assert decode(bytes.fromhex("1bffffffffffffffff")) == 2**64 - 1
+    assert decode(bytes.fromhex("3bffffffffffffffff")) == -2**64
+    assert decode(bytes.fromhex("3b7fffffffffffffff")) == -2**63
+    assert decode(bytes.fromhex("a1016178")) == {1: "x"}
+
+
+def test_decode_simple_values_and_tags():
+    assert decode(bytes.fromhex("f7")) == CborSimpleValue(23)
+    assert decode(bytes.fromhex("f0")) == CborSimpleValue(16)
+    tag = decode(bytes.fromhex("c11a6553f100"))
+    assert isinstance(tag, CborTag)
+    assert tag.tag == 1
+    assert tag.value == 1700000000
+    assert tag == CborTag(1, 1700000000)
+    # Nested tags and a tagged container
+    assert decode(bytes.fromhex("d820d8218101")) == CborTag(
+        32, CborTag(33, [1]))
+    # Tagged map key
+    assert decode(bytes.fromhex("a1c10001")) == {CborTag(1, 0): 1}
+
+
+def test_decode_typed_arrays():
+    # Tag 69: uint16, little endian
+    parsed = decode(bytes.fromhex("d84544 01000200"))
+    assert isinstance(parsed, np.ndarray)
+    assert parsed.dtype == np.dtype("<u2")
+    assert parsed.tolist() == [1, 2]
+    # Tag 82: float64, big endian
+    data = bytes.fromhex("d85250") + struct.pack(">2d", 1.5, -2.0)
+    parsed = decode(data)
+    assert parsed.dtype == np.dtype(">f8")
+    assert parsed.tolist() == [1.5, -2.0]
+    # Tag 72: sint8, inside an array
+    parsed = decode(bytes.fromhex("82d84843ff007f01"))
+    assert parsed[0].tolist() == [-1, 0, 127]
+    assert parsed[1] == 1
+    config = CborDecoderConfig()
+    config.typed_arrays = False
+    config.byte_string_views = False
+    assert decode(bytes.fromhex("d84843ff007f"), config) == CborTag(
+        72, b"\xff\x00\x7f")
+
+
+# Negative test cases
+
+
+def assert_not_decoded(result, expected_error_message=None):
+    assert len(result.error_message) != 0
+    if expected_error_message:
+        assert result.error_message.startswith(expected_error_message)
+    assert result.parsed is None
+
+
+def test_decode_non_existent_file():
+    decoder = CborDecoder(CborDecoderConfig())
+    decoding_result = decoder.decode("non_existent_file")
+    assert_not_decoded(decoding_result, CborDecoderError.FailedToOpenFile)
+
+
+@pytest.mark.parametrize("param", [
+    (bytes.fromhex("a2 0101 0102"),
+     CborDecoderError.DuplicateMapKey),
+    (bytes.fromhex("a18001"), CborDecoderError.UnhashableMapKey),
+    (bytes.fromhex("8201"), None),
+    (bytes.fromhex("ff"), None),
+    (b"", None),
+])
+def test_decode_invalid_bytes(param):
+    decoder = CborDecoder(CborDecoderConfig())
+    decoding_result = decoder.decode(param[0])
+    assert_not_decoded(decoding_result, param[1])
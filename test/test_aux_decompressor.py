@@ -0,0 +1,130 @@
+import bz2
+import gzip
+import lzma
+import zlib
+import pytest
+import numpy as np
+
+from pywuffs import *
+from pywuffs.aux import *
+
+DATA = b"".join(b"line %d: %s\n" % (i, b"pywuffs" * (i % 7)) for i in range(20000))
+
+
+def compress_deflate(data):
+    compressor = zlib.compressobj(wbits=-15)
+    return compressor.compress(data) + compressor.flush()
+
+
+COMPRESSED_DATA = [
+    (DecompressorType.DEFLATE, compress_deflate(DATA)),
+    (DecompressorType.GZIP, gzip.compress(DATA)),
+    (DecompressorType.ZLIB, zlib.compress(DATA)),
+    (DecompressorType.BZIP2, bz2.compress(DATA)),
+    (DecompressorType.LZMA, lzma.compress(DATA, format=lzma.FORMAT_ALONE)),
+    (DecompressorType.XZ, lzma.compress(DATA, format=lzma.FORMAT_XZ)),
+]
+
+
+def make_decompressor(decompressor_type, max_output_size=0):
+    config = DecompressorConfig()
+    config.type = decompressor_type
+    config.max_output_size = max_output_size
+    return Decompressor(config)
+
+
+# Positive test cases
+
+@pytest.mark.parametrize("param", COMPRESSED_DATA)
+def test_decompress(param):
+    decompressor = make_decompressor(param[0])
+    result = decompressor.decompress(param[1])
+    assert len(result.error_message) == 0
+    assert result.data.dtype == np.uint8
+    assert result.data.tobytes() == DATA
+
+
+@pytest.mark.parametrize("param", COMPRESSED_DATA)
+@pytest.mark.parametrize("chunk_size", [7, 1000, 1 << 20])
+def test_feed(param, chunk_size):
+    decompressor = make_decompressor(param[0])
+    for _ in range(2):
+        decompressed = b""
+        for i in range(0, len(param[1]), chunk_size):
+            decompressed += bytes(decompressor.feed(param[1][i:i + chunk_size]))
+        assert len(decompressor.error_message) == 0
+        assert decompressor.finished
+        assert decompressed == DATA
+        decompressor.reset()
+
+
+def test_feed_output_view():
+    decompressor = make_decompressor(DecompressorType.GZIP)
+    compressed = gzip.compress(DATA)
+    output = decompressor.feed(compressed)
+    assert output.dtype == np.uint8
+    assert not output.flags.writeable
+    with pytest.raises(ValueError):
+        output[0] = 0
+    # The output keeps the decompressor alive
+    del decompressor
+    assert output.tobytes() == DATA
+
+
+def test_feed_output_copy():
+    decompressor = make_decompressor(DecompressorType.GZIP)
+    compressed = gzip.compress(DATA)
+    first = decompressor.feed(compressed[:len(compressed) // 2], copy=True)
+    assert isinstance(first, bytes)
+    expected_first = bytes(first)
+    second = decompressor.feed(compressed[len(compressed) // 2:], copy=True)
+    assert first == expected_first
+    assert first + second == DATA
+    decompressor.reset()
+    del decompressor
+    assert first + second == DATA
+
+
+def test_max_output_size_not_exceeded():
+    decompressor = make_decompressor(DecompressorType.GZIP, len(DATA))
+    result = decompressor.decompress(gzip.compress(DATA))
+    assert len(result.error_message) == 0
+    assert result.data.tobytes() == DATA
+
+
+# Negative test cases
+
+@pytest.mark.parametrize("param", COMPRESSED_DATA)
+def test_decompress_max_output_size_exceeded(param):
+    decompressor = make_decompressor(param[0], len(DATA) - 1)
+    result = decompressor.decompress(param[1])
+    assert result.error_message == DecompressorError.MaxOutputSizeExceeded
+    assert len(result.data) <= len(DATA) - 1
+    assert DATA.startswith(result.data.tobytes())
+
+
+def test_feed_max_output_size_exceeded():
+    decompressor = make_decompressor(DecompressorType.GZIP, 1000)
+    compressed = gzip.compress(DATA)
+    decompressed = bytes(decompressor.feed(compressed[:len(compressed) // 2]))
+    assert decompressor.error_message == DecompressorError.MaxOutputSizeExceeded
+    assert len(decompressed) <= 1000
+    assert DATA.startswith(decompressed)
+    assert len(decompressor.feed(compressed[len(compressed) // 2:])) == 0
+
+
+@pytest.mark.parametrize("param", COMPRESSED_DATA)
+def test_decompress_truncated_data(param):
+    decompressor = make_decompressor(param[0])
+    result = decompressor.decompress(param[1][:len(param[1]) // 2])
+    assert result.error_message == DecompressorError.UnexpectedEndOfFile
+    decompressor.feed(param[1][:len(param[1]) // 2])
+    assert len(decompressor.error_message) == 0
+    assert not decompressor.finished
+
+
+@pytest.mark.parametrize("param", COMPRESSED_DATA)
+def test_decompress_invalid_data(param):
+    decompressor = make_decompressor(param[0])
+    result = decompressor.decompress(b"\xff" * 100)
+    assert len(result.error_message) != 0
@@ -0,0 +1,104 @@
+import hashlib
+import threading
+import zlib
+import pytest
+import numpy as np
+
+import pywuffs
+
+DATA = [b"", b"abc", bytes(range(256)) * 4097]
+
+# Positive test cases
+
+
+def reference_digests(data):
+    return {
+        "crc32": zlib.crc32(data),
+        "adler32": zlib.adler32(data),
+        "sha256": hashlib.sha256(data).digest(),
+    }
+
+
+@pytest.mark.parametrize("data", DATA)
+@pytest.mark.parametrize("name", ["crc32", "adler32", "sha256"])
+def test_hash(data, name):
+    function = getattr(pywuffs.hash, name)
+    expected = reference_digests(data)[name]
+    assert function(data) == expected
+    assert function(bytearray(data)) == expected
+    assert function(memoryview(data)) == expected
+    assert function(np.frombuffer(data, dtype=np.uint8)) == expected
+
+
+@pytest.mark.parametrize("param", [
+    (pywuffs.hash.xxhash32, b"", 0x02CC5D05),
+    (pywuffs.hash.xxhash32, b"abc", 0x32D153FF),
+    (pywuffs.hash.xxhash64, b"", 0xEF46DB3751D8E999),
+    (pywuffs.hash.xxhash64, b"abc", 0x44BC2CF5AD770999),
+])
+def test_xxhash(param):
+    assert param[0](param[1]) == param[2]
+
+
+@pytest.mark.parametrize("name", ["crc32", "adler32", "xxhash32", "xxhash64", "sha256"])
+@pytest.mark.parametrize("num_threads", [0, 1, 3])
+def test_hash_many(name, num_threads):
+    function = getattr(pywuffs.hash, name)
+    assert function(DATA, num_threads) == [function(d) for d in DATA]
+    assert function([]) == []
+
+
+@pytest.mark.parametrize("param", [
+    (pywuffs.hash.Crc32, pywuffs.hash.crc32),
+    (pywuffs.hash.Adler32, pywuffs.hash.adler32),
+    (pywuffs.hash.XxHash32, pywuffs.hash.xxhash32),
+    (pywuffs.hash.XxHash64, pywuffs.hash.xxhash64),
+    (pywuffs.hash.Sha256, pywuffs.hash.sha256),
+])
+def test_hasher(param):
+    data = DATA[-1]
+    hasher = param[0]()
+    assert hasher.digest() == param[1](b"")
+    for i in range(0, len(data), 1000):
+        hasher.update(data[i:i + 1000])
+    assert hasher.digest() == param[1](data)
+    hasher.reset()
+    hasher.update(b"abc")
+    assert hasher.digest() == param[1](b"abc")
+
+
+@pytest.mark.parametrize("param", [
+    (pywuffs.hash.Crc32, pywuffs.hash.crc32),
+    (pywuffs.hash.Sha256, pywuffs.hash.sha256),
+])
+@pytest.mark.parametrize("chunk_size", [100, 100000])
+def test_hasher_shared_between_threads(param, chunk_size):
+    # The chunks are all the same, so that the digest doesn't depend on the
+    # order of the updates
+    chunk = bytes(range(256)) * (chunk_size // 256 + 1)
+    num_threads = 4
+    num_updates = 50
+    hasher = param[0]()
+
+    def update():
+        for _ in range(num_updates):
+            hasher.update(chunk)
+            hasher.digest()
+
+    threads = [threading.Thread(target=update) for _ in range(num_threads)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert hasher.digest() == param[1](chunk * (num_threads * num_updates))
+
+
+# Negative test cases
+
+
+def test_hash_non_contiguous_buffer():
+    data = np.arange(16, dtype=np.uint8)[::2]
+    with pytest.raises(ValueError):
+        pywuffs.hash.crc32(data)
+    with pytest.raises(TypeError):
+        pywuffs.hash.crc32("abc")
@@ -1,5 +1,10 @@
+import io
 import os
-from struct import unpack
+import gzip
+import lzma
+import zipfile
+import zlib
+from struct import pack, unpack
 import pytest
 import numpy as np
 
@@ -173,6 +178,53 @@ def test_decode_image_flags(test_image, flag):
     assert_decoded(decoding_result, None)
 
 
+@pytest.mark.parametrize("param", [
+    (InputCompression.GZIP, gzip.compress),
+    (InputCompression.XZ, lzma.compress),
+])
+@pytest.mark.parametrize("test_image", TEST_IMAGES)
+def test_decode_compressed(param, test_image, tmp_path):
+    decoder = ImageDecoder(ImageDecoderConfig())
+    expected_result = decoder.decode(test_image[1])
+    with open(test_image[1], "rb") as f:
+        compressed_data = param[1](f.read())
+    file_path = tmp_path / "image.compressed"
+    file_path.write_bytes(compressed_data)
+    config = ImageDecoderConfig()
+    config.compression = param[0]
+    decoder = ImageDecoder(config)
+    for decoding_result in [decoder.decode(compressed_data), decoder.decode(str(file_path))]:
+        assert_decoded(decoding_result)
+        assert np.array_equal(decoding_result.pixbuf, expected_result.pixbuf)
+
+
+class ReadOnlyFile:
+    # A file-like object without readinto, returning short reads
+    def __init__(self, data):
+        self.data = data
+
+    def read(self, size):
+        size = min(size, 1000)
+        chunk, self.data = self.data[:size], self.data[size:]
+        return chunk
+
+
+@pytest.mark.parametrize("test_image", TEST_IMAGES)
+def test_decode_file_like(test_image, tmp_path):
+    decoder = ImageDecoder(ImageDecoderConfig())
+    expected_result = decoder.decode(test_image[1])
+    with open(test_image[1], "rb") as f:
+        data = f.read()
+    zip_path = tmp_path / "images.zip"
+    with zipfile.ZipFile(zip_path, "w", zipfile.ZIP_DEFLATED) as z:
+        z.writestr("image", data)
+    with open(test_image[1], "rb") as f, zipfile.ZipFile(zip_path) as z, z.open("image") as member:
+        for file in [f, io.BytesIO(data), ReadOnlyFile(data), member]:
+            decoding_result = decoder.decode(file)
+            assert_decoded(decoding_result)
+            assert np.array_equal(decoding_result.pixbuf, expected_result.pixbuf)
+
+
 def test_decode_image_exif_metadata():
     config = ImageDecoderConfig()
     config.flags = [ImageDecoderFlags.REPORT_METADATA_EXIF]
@@ -198,6 +250,204 @@ def test_decode_image_exif_metadata():
     assert exif_orientation == 3
 
 
+@pytest.mark.parametrize("crop", [(3, 5, 10, 7), (0, 0, 1, 1), (8, 8, 100000, 100000)])
+@pytest.mark.parametrize("test_image", TEST_IMAGES)
+def test_decode_crop(crop, test_image):
+    expected_pixbuf = ImageDecoder(ImageDecoderConfig()).decode(test_image[1]).pixbuf
+    config = ImageDecoderConfig()
+    config.crop = crop
+    decoder = ImageDecoder(config)
+    x, y, width, height = crop
+    # The decoder is reused to check that the frame buffer reuse is harmless
+    for _ in range(2):
+        decoding_result = decoder.decode(test_image[1])
+        assert_decoded(decoding_result)
+        assert np.array_equal(decoding_result.pixbuf, expected_pixbuf[y:y + height, x:x + width])
+
+
+def with_exif_orientation(png_data, orientation):
+    # Patches the orientation tag of the eXIf chunk and its CRC
+    chunk_start = png_data.find(b"eXIf") - 4
+    chunk_length = unpack(">I", png_data[chunk_start:chunk_start + 4])[0]
+    chunk_end = chunk_start + 8 + chunk_length
+    exif = png_data[chunk_start + 8:chunk_end]
+    tag = exif.find(b"\x12\x01\x03\x00\x01\x00\x00\x00")
+    exif = exif[:tag + 8] + pack("<H", orientation) + exif[tag + 10:]
+    chunk_type_and_data = b"eXIf" + exif
+    return (png_data[:chunk_start + 4] + chunk_type_and_data +
+            pack(">I", zlib.crc32(chunk_type_and_data)) + png_data[chunk_end + 4:])
+
+
+def with_jpeg_exif_orientation(jpeg_data, orientation):
+    # Patches the orientation tag of the APP1 EXIF segment
+    tag = jpeg_data.find(b"\x12\x01\x03\x00\x01\x00\x00\x00")
+    return jpeg_data[:tag + 8] + pack("<H", orientation) + jpeg_data[tag + 10:]
+
+
+@pytest.mark.parametrize("crop", [(0, 0, 0, 0), (3, 5, 10, 7)])
+@pytest.mark.parametrize("orientation", range(1, 9))
+@pytest.mark.parametrize("test_image", [
+    # The JPEG decoder doesn't report the EXIF metadata
+    ("lena_exif.png", with_exif_orientation, 1),
+    ("lena.jpeg", with_jpeg_exif_orientation, None),
+])
+def test_decode_apply_exif_orientation(orientation, crop, test_image):
+    file_name, patch_orientation, expected_metadata_len = test_image
+    with open(os.path.join(IMAGES_PATH, file_name), "rb") as f:
+        data = patch_orientation(f.read(), orientation)
+    expected_pixbuf = ImageDecoder(ImageDecoderConfig()).decode(data).pixbuf
+    expected_pixbuf = {
+        1: lambda p: p,
+        2: lambda p: p[:, ::-1],
+        3: lambda p: p[::-1, ::-1],
+        4: lambda p: p[::-1],
+        5: lambda p: p.transpose(1, 0, 2),
+        6: lambda p: np.rot90(p, -1),
+        7: lambda p: p[::-1, ::-1].transpose(1, 0, 2),
+        8: lambda p: np.rot90(p, 1),
+    }[orientation](expected_pixbuf)
+    if crop[2] != 0:
+        x, y, width, height = crop
+        expected_pixbuf = expected_pixbuf[y:y + height, x:x + width]
+    config = ImageDecoderConfig()
+    config.apply_exif_orientation = True
+    config.crop = crop
+    decoding_result = ImageDecoder(config).decode(data)
+    assert_decoded(decoding_result)
+    assert np.array_equal(decoding_result.pixbuf, expected_pixbuf)
+    config.flags = [ImageDecoderFlags.REPORT_METADATA_EXIF]
+    decoding_result = ImageDecoder(config).decode(data)
+    assert_decoded(decoding_result, expected_metadata_len)
+    assert np.array_equal(decoding_result.pixbuf, expected_pixbuf)
+
+
+@pytest.mark.parametrize("test_image", TEST_IMAGES)
+def test_decode_stats(test_image):
+    decoder = ImageDecoder(ImageDecoderConfig())
+    assert decoder.decode(test_image[1]).stats is None
+    config = ImageDecoderConfig()
+    config.collect_stats = True
+    decoder = ImageDecoder(config)
+    with open(test_image[1], "rb") as f:
+        data = f.read()
+    for decoding_result in [decoder.decode(data), decoder.decode(test_image[1])]:
+        stats = decoding_result.stats
+        assert list(stats["phases"]) == ["sniff", "select_decoder", "header", "alloc_pixbuf", "pixels"]
+        assert all(seconds >= 0 for seconds in stats["phases"].values())
+        assert 0 < stats["input_bytes"] <= len(data)
+        assert stats["output_bytes"] == decoding_result.pixcfg.pixbuf_len()
+        assert_decoded(decoding_result)
+        assert list(decoding_result.stats["phases"])[-1] == "python_conversion"
+    assert decoder.decode(data).stats["input_bytes"] == len(data)
+
+
+ALL_STATISTICS = [ImageStatistic.LUMA_HISTOGRAM, ImageStatistic.MEAN_STD, ImageStatistic.MIN_MAX,
+                  ImageStatistic.DHASH, ImageStatistic.PHASH]
+
+
+def luma_grid(luma, width, height):
+    # Averages the luma down to width x height cells, repeating the pixels along the axes shorter than the grid
+    def cell_matrix(n, cells):
+        matrix = np.zeros((cells, n))
+        for cell in range(cells):
+            if n >= cells:
+                matrix[cell, [i for i in range(n) if i * cells // n == cell]] = 1
+            else:
+                matrix[cell, cell * n // cells] = 1
+        return matrix
+
+    rows = cell_matrix(luma.shape[0], height)
+    columns = cell_matrix(luma.shape[1], width)
+    return (rows @ luma @ columns.T) / np.outer(rows.sum(axis=1), columns.sum(axis=1))
+
+
+def hash_of(bits):
+    return int("".join("1" if bit else "0" for bit in bits.flatten()), 2)
+
+
+def assert_statistics(statistics, pixbuf, rgb_indices):
+    pixels = pixbuf.reshape(-1, pixbuf.shape[2]).astype(np.int64)
+    r, g, b = (pixbuf[..., i].astype(np.int64) for i in rgb_indices)
+    luma = (77 * r + 150 * g + 29 * b + 128) >> 8
+    assert statistics["luma_histogram"].dtype == np.uint64
+    assert np.array_equal(statistics["luma_histogram"], np.bincount(luma.flatten(), minlength=256))
+    assert np.allclose(statistics["mean"], pixels.mean(axis=0))
+    assert np.allclose(statistics["std"], pixels.std(axis=0))
+    assert statistics["min"] == list(pixels.min(axis=0))
+    assert statistics["max"] == list(pixels.max(axis=0))
+    dhash_grid = luma_grid(luma, 9, 8)
+    assert statistics["dhash"] == hash_of(dhash_grid[:, 1:] > dhash_grid[:, :-1])
+    if min(luma.shape) >= 32:
+        # The hash of an image smaller than the DCT grid is not meaningful
+        cosines = np.cos(np.pi * np.outer(np.arange(8), 2 * np.arange(32) + 1) / 64)
+        coefficients = cosines @ luma_grid(luma, 32, 32) @ cosines.T
+        median = np.median(coefficients)
+        expected_phash = hash_of(coefficients > median)
+        # Only the bits of the coefficients which are not tied with the median are stable
+        stable_bits = hash_of(~np.isclose(coefficients, median, rtol=1e-9, atol=1e-9))
+        assert (statistics["phash"] ^ expected_phash) & stable_bits == 0
+    assert 0 <= statistics["phash"] < 2 ** 64
+
+
+@pytest.mark.parametrize("pixel_format, rgb_indices", [
+    (PixelFormat.BGRA_PREMUL, (2, 1, 0)),
+    (PixelFormat.BGR, (2, 1, 0)),
+    (PixelFormat.RGBA_NONPREMUL, (0, 1, 2)),
+])
+@pytest.mark.parametrize("test_image", TEST_IMAGES)
+def test_decode_compute_statistics(pixel_format, rgb_indices, test_image):
+    config = ImageDecoderConfig()
+    config.pixel_format = pixel_format
+    expected_pixbuf = ImageDecoder(config).decode(test_image[1]).pixbuf
+    assert ImageDecoder(config).decode(test_image[1]).statistics is None
+    config.compute = ALL_STATISTICS
+    decoding_result = ImageDecoder(config).decode(test_image[1])
+    assert_decoded(decoding_result)
+    assert np.array_equal(decoding_result.pixbuf, expected_pixbuf)
+    assert_statistics(decoding_result.statistics, expected_pixbuf, rgb_indices)
+    config.compute = [ImageStatistic.DHASH, ImageStatistic.MIN_MAX]
+    statistics = ImageDecoder(config).decode(test_image[1]).statistics
+    assert sorted(statistics) == ["dhash", "max", "min"]
+    assert statistics["dhash"] == decoding_result.statistics["dhash"]
+
+
+@pytest.mark.parametrize("test_image", TEST_IMAGES)
+def test_decode_compute_statistics_only(test_image):
+    expected_result = ImageDecoder(ImageDecoderConfig()).decode(test_image[1])
+    config = ImageDecoderConfig()
+    config.compute = ALL_STATISTICS
+    config.return_pixbuf = False
+    config.collect_stats = True
+    decoder = ImageDecoder(config)
+    # The decoder is reused to check that the frame buffer reuse is harmless
+    for _ in range(2):
+        decoding_result = decoder.decode(test_image[1])
+        assert len(decoding_result.error_message) == 0
+        assert decoding_result.pixbuf.size == 0
+        assert decoding_result.pixcfg.width() == expected_result.pixcfg.width()
+        assert decoding_result.pixcfg.height() == expected_result.pixcfg.height()
+        assert_statistics(decoding_result.statistics, expected_result.pixbuf, (2, 1, 0))
+        assert list(decoding_result.stats["phases"])[-2:] == ["pixels", "statistics"]
+        assert decoding_result.stats["output_bytes"] == 0
+
+
+@pytest.mark.parametrize("return_pixbuf", [True, False])
+def test_decode_compute_statistics_cropped(return_pixbuf):
+    x, y, width, height = 3, 5, 40, 35
+    expected_pixbuf = ImageDecoder(ImageDecoderConfig()).decode(TEST_IMAGES[0][1]).pixbuf
+    expected_pixbuf = expected_pixbuf[y:y + height, x:x + width]
+    config = ImageDecoderConfig()
+    config.crop = (x, y, width, height)
+    config.compute = ALL_STATISTICS
+    config.return_pixbuf = return_pixbuf
+    decoding_result = ImageDecoder(config).decode(TEST_IMAGES[0][1])
+    assert len(decoding_result.error_message) == 0
+    assert decoding_result.pixcfg.width() == width
+    assert decoding_result.pixcfg.height() == height
+    assert decoding_result.pixbuf.size == (expected_pixbuf.size if return_pixbuf else 0)
+    assert_statistics(decoding_result.statistics, expected_pixbuf, (2, 1, 0))
+
+
 # Negative test cases
 
 def assert_not_decoded(result, expected_error_message=None, expected_metadata_length=0):
@@ -233,6 +483,60 @@ def test_decode_invalid_bytes(param):
     assert_not_decoded(decoding_result, ImageDecoderError.UnsupportedImageFormat)
 
 
+def test_decode_file_like_read_error():
+    class FailingFile:
+        def readinto(self, buffer):
+            raise OSError("connection reset")
+
+    decoding_result = ImageDecoder(ImageDecoderConfig()).decode(FailingFile())
+    assert_not_decoded(decoding_result)
+    assert decoding_result.error_message.startswith(ImageDecoderError.FailedToReadFile)
+    assert "connection reset" in decoding_result.error_message
+
+
+def test_decode_not_file_like():
+    with pytest.raises(TypeError):
+        ImageDecoder(ImageDecoderConfig()).decode(123)
+
+
+def test_decode_invalid_bytes_stats():
+    config = ImageDecoderConfig()
+    config.collect_stats = True
+    decoder = ImageDecoder(config)
+    decoding_result = decoder.decode(b"123")
+    assert_not_decoded(decoding_result, ImageDecoderError.UnsupportedImageFormat)
+    assert list(decoding_result.stats["phases"]) == ["sniff"]
+    assert decoding_result.stats["output_bytes"] == 0
+
+
+def test_decode_crop_out_of_bounds():
+    config = ImageDecoderConfig()
+    config.crop = (100000, 0, 10, 10)
+    decoder = ImageDecoder(config)
+    decoding_result = decoder.decode(TEST_IMAGES[0][1])
+    assert_not_decoded(decoding_result, ImageDecoderError.CropOutOfBounds)
+
+
+def test_decode_compute_statistics_unsupported_pixel_format():
+    config = ImageDecoderConfig()
+    config.pixel_format = PixelFormat.BGR_565
+    config.compute = [ImageStatistic.MEAN_STD]
+    decoder = ImageDecoder(config)
+    decoding_result = decoder.decode(TEST_IMAGES[0][1])
+    assert_not_decoded(decoding_result, ImageDecoderError.UnsupportedStatisticsPixelFormat)
+    assert decoding_result.statistics is None
+
+
+def test_decode_invalid_compressed_bytes():
+    config = ImageDecoderConfig()
+    config.compression = InputCompression.GZIP
+    decoder = ImageDecoder(config)
+    with open(TEST_IMAGES[0][1], "rb") as f:
+        data = f.read()
+    assert_not_decoded(decoder.decode(data))
+    assert_not_decoded(decoder.decode(gzip.compress(data)[:-100]))
+
+
 @pytest.mark.parametrize("param", TEST_IMAGES)
 def test_decode_image_formats_truncated(param):
     config = ImageDecoderConfig()
@@ -1,6 +1,11 @@
+import io
 import os
+import bz2
+import gzip
 import json
+import zlib
 import pytest
+import numpy as np
 
 from pywuffs import *
 from pywuffs.aux import *
@@ -58,6 +63,303 @@ def test_decode_json_pointer():
     assert_decoded(decoding_result, encoded=bytes(
         json.dumps(data["key2"]), "utf-8"))
 
+@pytest.mark.parametrize("file_path", [
+    (JSON_PATH + "/simple.json"),
+    (JSON_PATH + "/valid1.json"),
+])
+def test_validate(file_path):
+    decoder = JsonDecoder(JsonDecoderConfig())
+    with open(file_path, "rb") as f:
+        data = f.read()
+    for validation_result in [decoder.validate(data), decoder.validate(file_path)]:
+        assert len(validation_result.error_message) == 0
+        assert validation_result.cursor_position == decoder.decode(data).cursor_position
+
+
+def test_decode_json_pointers():
+    data = {"key1": 1, "key2": [2, 3], "items": [{"id": 4, "val": [5]}, {"id": "6"}, {"val": 7}],
+            "a/b": {"c~d": None}}
+    config = JsonDecoderConfig()
+    config.json_pointers = ["/key2", "/key2/1", "/items/*/id", "/items/0/val", "/a~1b/c~0d", "", "/random",
+                            "/random/*"]
+    decoder = JsonDecoder(config)
+    decoding_result = decoder.decode(bytes(json.dumps(data), "utf-8"))
+    assert len(decoding_result.error_message) == 0
+    assert decoding_result.parsed == {
+        "/key2": [2, 3],
+        "/key2/1": 3,
+        "/items/*/id": [4, "6"],
+        "/items/0/val": [5],
+        "/a~1b/c~0d": None,
+        "": data,
+        "/random/*": [],
+    }
+
+
+def test_decode_numeric_arrays():
+    data = {"ints": [1, 2, 3], "floats": [1, 2.5], "matrix": [[1, 2], [3, 4], [5, 6]],
+            "ragged": [[1, 2], [3]], "mixed": [1, "2", 3.5], "empty": [], "nested": [[[1.5]]]}
+    config = JsonDecoderConfig()
+    config.numeric_array_max_ndim = 2
+    decoder = JsonDecoder(config)
+    decoding_result = decoder.decode(bytes(json.dumps(data), "utf-8"))
+    assert len(decoding_result.error_message) == 0
+    parsed = decoding_result.parsed
+    assert parsed["ints"].dtype == np.int64
+    assert np.array_equal(parsed["ints"], data["ints"])
+    assert parsed["floats"].dtype == np.float64
+    assert np.array_equal(parsed["floats"], data["floats"])
+    assert parsed["matrix"].dtype == np.int64
+    assert parsed["matrix"].shape == (3, 2)
+    assert np.array_equal(parsed["matrix"], data["matrix"])
+    assert isinstance(parsed["ragged"], list)
+    assert [row.tolist() for row in parsed["ragged"]] == data["ragged"]
+    assert parsed["mixed"] == data["mixed"]
+    assert type(parsed["mixed"][0]) is int
+    assert parsed["empty"] == []
+    assert isinstance(parsed["nested"], list)
+    assert parsed["nested"][0].shape == (1, 1)
+
+
+def column_values(column):
+    data, mask = column["data"], column["mask"]
+    if column["type"] == JsonColumnType.STRING:
+        offsets = column["offsets"]
+        data = [data[offsets[i]:offsets[i + 1]].tobytes().decode("utf-8") for i in range(len(mask))]
+    return [None if m else v for v, m in zip(list(data), mask)]
+
+
+def test_decode_columnar():
+    records = [
+        {"i": 1, "f": 1, "s": "a", "b": True, "o": [1]},
+        {"i": 2, "f": 2.5, "s": "éé", "b": None, "o": "x", "n": None},
+        {"i": 3, "s": "", "b": False, "o": {"k": None}},
+    ]
+    decoder = JsonDecoder(JsonDecoderConfig())
+    decoding_result = decoder.decode_columnar(bytes(json.dumps(records), "utf-8"))
+    assert len(decoding_result.error_message) == 0
+    columns = decoding_result.parsed
+    assert list(columns.keys()) == ["i", "f", "s", "b", "o", "n"]
+    expected = {
+        "i": (JsonColumnType.INT64, np.int64),
+        "f": (JsonColumnType.FLOAT64, np.float64),
+        "s": (JsonColumnType.STRING, np.uint8),
+        "b": (JsonColumnType.BOOL, np.bool_),
+        "o": (JsonColumnType.OBJECT, np.object_),
+        "n": (JsonColumnType.OBJECT, np.object_),
+    }
+    for key, (column_type, dtype) in expected.items():
+        assert columns[key]["type"] == column_type
+        assert columns[key]["data"].dtype == dtype
+        assert columns[key]["mask"].dtype == np.bool_
+        assert column_values(columns[key]) == [record.get(key) for record in records]
+    assert np.isnan(columns["f"]["data"][2])
+
+
+def test_decode_columnar_schema():
+    config = JsonDecoderConfig()
+    config.json_pointer = "/rows"
+    decoder = JsonDecoder(config)
+    data = b'{"rows": [{"a": 1, "b": "x", "c": 2}, {"a": 2.5, "c": [3]}]}'
+    decoding_result = decoder.decode_columnar(data, {"c": JsonColumnType.OBJECT, "a": JsonColumnType.FLOAT64,
+                                                     "d": JsonColumnType.STRING})
+    assert len(decoding_result.error_message) == 0
+    columns = decoding_result.parsed
+    assert list(columns.keys()) == ["c", "a", "d"]
+    assert column_values(columns["c"]) == [2, [3]]
+    assert column_values(columns["a"]) == [1.0, 2.5]
+    assert column_values(columns["d"]) == [None, None]
+    assert list(columns["d"]["offsets"]) == [0, 0, 0]
+
+
+@pytest.mark.parametrize("num_threads", [0, 1, 4])
+def test_decode_many(num_threads):
+    documents = [{"key1": i, "key2": [i, str(i), 1.5, None, True]} for i in range(64)]
+    data = [bytes(json.dumps(d), "utf-8") for d in documents]
+    decoder = JsonDecoder(JsonDecoderConfig())
+    results = decoder.decode_many(data, num_threads)
+    assert len(results) == len(documents)
+    for result, encoded in zip(results, data):
+        assert_decoded(result, encoded=encoded)
+        decoding_result = decoder.decode(encoded)
+        assert result.cursor_position == decoding_result.cursor_position
+
+
+@pytest.mark.parametrize("num_threads", [0, 1, 4])
+@pytest.mark.parametrize("document", [
+    [{"key1": i, "key2": [i, str(i) + ",]}\\\"", 1.5, None, True]} for i in range(20000)],
+    {"key" + str(i): {"value": [i, "]}" * (i % 3)]} for i in range(20000)},
+])
+def test_decode_parallel(num_threads, document):
+    encoded = bytes(json.dumps(document), "utf-8")
+    decoder = JsonDecoder(JsonDecoderConfig())
+    decoding_result = decoder.decode_parallel(encoded, num_threads)
+    assert_decoded(decoding_result, encoded=encoded)
+    assert decoding_result.cursor_position == decoder.decode(encoded).cursor_position
+
+
+def test_decode_stats():
+    data = b'{"key1": [1, 2.5, "value"], "key2": null}'
+    assert JsonDecoder(JsonDecoderConfig()).decode(data).stats is None
+    config = JsonDecoderConfig()
+    config.collect_stats = True
+    decoder = JsonDecoder(config)
+    stats = decoder.decode(data).stats
+    assert list(stats["phases"]) == ["decode"]
+    assert stats["phases"]["decode"] >= 0
+    assert stats["input_bytes"] == len(data)
+    stats = decoder.decode_many([data])[0].stats
+    assert list(stats["phases"]) == ["parse", "python_conversion"]
+    assert stats["input_bytes"] == len(data)
+    data = bytes(json.dumps(list(range(100000))), "utf-8")
+    stats = decoder.decode_parallel(data, num_threads=2).stats
+    assert list(stats["phases"]) == ["parse", "python_conversion"]
+    assert stats["input_bytes"] == len(data)
+
+
+def test_iter_records(tmp_path):
+    records = [{"key1": 1, "key2": [2, 3]}, [1.5, "value"], "value", 123, None]
+    data = b"".join(bytes(json.dumps(r), "utf-8") + b"\n" for r in records)
+    file_path = tmp_path / "records.jsonl"
+    file_path.write_bytes(data)
+    decoder = JsonDecoder(JsonDecoderConfig())
+    for source in (data, str(file_path), io.BytesIO(data)):
+        results = list(decoder.iter_records(source))
+        assert len(results) == len(records)
+        for result in results:
+            assert len(result.error_message) == 0
+        assert [result.parsed for result in results] == records
+        assert results[-1].cursor_position == len(data) - 1
+
+
+def test_iter_records_concatenated():
+    data = b"{\"key\": 1}{\"key\": 2}  [3]\n\n\"value\"\n  4"
+    decoder = JsonDecoder(JsonDecoderConfig())
+    results = list(decoder.iter_records(data))
+    assert [result.parsed for result in results] == [{"key": 1}, {"key": 2}, [3], "value", 4]
+
+
+def test_iter_records_batches():
+    data = b"\n".join(bytes(str(i), "utf-8") for i in range(5))
+    decoder = JsonDecoder(JsonDecoderConfig())
+    batches = list(decoder.iter_records(data, batch_size=2))
+    assert [[result.parsed for result in batch] for batch in batches] == [[0, 1], [2, 3], [4]]
+
+
+def test_iter_records_json_pointer():
+    data = b"{\"key1\": 1, \"key2\": [2, 3]}\n{\"key2\": 4, \"key3\": 5}\n"
+    config = JsonDecoderConfig()
+    config.json_pointer = "/key2"
+    decoder = JsonDecoder(config)
+    results = list(decoder.iter_records(data))
+    assert [result.parsed for result in results] == [[2, 3], 4]
+
+def test_iterparse(tmp_path):
+    data = b'{"a": [1, 2.5, {"b": null}], "c": true, "d": "x\\u00e9"}'
+    file_path = tmp_path / "document.json"
+    file_path.write_bytes(data)
+    expected_events = [
+        ("", "start_map", None),
+        ("", "map_key", "a"),
+        ("a", "start_array", None),
+        ("a.item", "number", 1),
+        ("a.item", "number", 2.5),
+        ("a.item", "start_map", None),
+        ("a.item", "map_key", "b"),
+        ("a.item.b", "null", None),
+        ("a.item", "end_map", None),
+        ("a", "end_array", None),
+        ("", "map_key", "c"),
+        ("c", "boolean", True),
+        ("", "map_key", "d"),
+        ("d", "string", "x\u00e9"),
+        ("", "end_map", None),
+    ]
+    decoder = JsonDecoder(JsonDecoderConfig())
+    for source in [data, str(file_path), io.BytesIO(data)]:
+        parser = decoder.iterparse(source)
+        assert list(parser) == expected_events
+        assert len(parser.error_message) == 0
+        assert parser.cursor_position == len(data)
+    filtered_events = list(decoder.iterparse(data, prefix_filter="a.item"))
+    assert filtered_events == [e for e in expected_events if e[0].startswith("a.item")]
+
+
+@pytest.mark.parametrize("param", [
+    (InputCompression.GZIP, gzip.compress),
+    (InputCompression.ZLIB, zlib.compress),
+    (InputCompression.BZIP2, bz2.compress),
+])
+def test_decode_compressed(param, tmp_path):
+    data = json.dumps([{"id": i, "name": "name%d" % i} for i in range(10000)]).encode("utf-8")
+    compressed_data = param[1](data)
+    file_path = tmp_path / "document.json.compressed"
+    file_path.write_bytes(compressed_data)
+    config = JsonDecoderConfig()
+    config.compression = param[0]
+    decoder = JsonDecoder(config)
+    assert_decoded(decoder.decode(compressed_data), encoded=data)
+    assert_decoded(decoder.decode(str(file_path)), encoded=data)
+    assert decoder.decode_many([compressed_data])[0].parsed == json.loads(data)
+    assert len(decoder.validate(compressed_data).error_message) == 0
+    columns = decoder.decode_columnar(compressed_data).parsed
+    assert column_values(columns["id"]) == list(range(10000))
+
+
+@pytest.mark.parametrize("param", [
+    (InputCompression.GZIP, gzip.compress),
+    (InputCompression.ZLIB, zlib.compress),
+    (InputCompression.BZIP2, bz2.compress),
+])
+def test_iter_records_compressed(param, tmp_path):
+    # Larger than the record reader's buffer
+    records = [{"id": i, "name": "name%d" % i} for i in range(10000)]
+    data = b"".join(bytes(json.dumps(r), "utf-8") + b"\n" for r in records)
+    compressed_data = param[1](data)
+    file_path = tmp_path / "records.jsonl.compressed"
+    file_path.write_bytes(compressed_data)
+    config = JsonDecoderConfig()
+    config.compression = param[0]
+    decoder = JsonDecoder(config)
+    for source in (compressed_data, str(file_path), io.BytesIO(compressed_data)):
+        results = list(decoder.iter_records(source))
+        assert all(len(result.error_message) == 0 for result in results)
+        assert [result.parsed for result in results] == records
+
+
+@pytest.mark.parametrize("param", [
+    (InputCompression.GZIP, gzip.compress),
+    (InputCompression.ZLIB, zlib.compress),
+    (InputCompression.BZIP2, bz2.compress),
+])
+def test_iterparse_compressed(param, tmp_path):
+    data = json.dumps({"items": [{"id": i, "name": "name%d" % i} for i in range(10000)]}).encode("utf-8")
+    expected_events = list(JsonDecoder(JsonDecoderConfig()).iterparse(data))
+    compressed_data = param[1](data)
+    file_path = tmp_path / "document.json.compressed"
+    file_path.write_bytes(compressed_data)
+    config = JsonDecoderConfig()
+    config.compression = param[0]
+    decoder = JsonDecoder(config)
+    for source in (compressed_data, str(file_path), io.BytesIO(compressed_data)):
+        parser = decoder.iterparse(source)
+        assert list(parser) == expected_events
+        assert len(parser.error_message) == 0
+
+
+def test_decode_file_like(tmp_path):
+    data = json.dumps([{"id": i, "name": "name%d" % i} for i in range(10000)]).encode("utf-8")
+    file_path = tmp_path / "document.json.gz"
+    file_path.write_bytes(gzip.compress(data))
+    decoder = JsonDecoder(JsonDecoderConfig())
+    with gzip.open(file_path) as f:
+        assert_decoded(decoder.decode(f), encoded=data)
+    assert_decoded(decoder.decode(io.BytesIO(data)), encoded=data)
+    validation_result = decoder.validate(io.BytesIO(data))
+    assert len(validation_result.error_message) == 0
+    assert validation_result.cursor_position == len(data)
+
+
 # Negative test cases
 
 
@@ -68,6 +370,13 @@ def assert_not_decoded(result, expected_error_message=None):
     assert result.parsed is None
 
 
+def test_decode_text_file_like():
+    decoder = JsonDecoder(JsonDecoderConfig())
+    assert_not_decoded(decoder.decode(io.StringIO("[1, 2]")))
+    with pytest.raises(TypeError):
+        decoder.decode(123)
+
+
 def test_decode_non_existent_file():
     decoder = JsonDecoder(JsonDecoderConfig())
     decoding_result = decoder.decode("random123")
@@ -98,6 +407,36 @@ def test_decode_invalid_file(param):
     assert_not_decoded(decoding_result, param[1])
 
 
+def test_decode_invalid_compressed_bytes():
+    data = b"[1, 2, 3]"
+    config = JsonDecoderConfig()
+    config.compression = InputCompression.GZIP
+    decoder = JsonDecoder(config)
+    assert_not_decoded(decoder.decode(data))
+    assert_not_decoded(decoder.decode(gzip.compress(data)[:-10]))
+    assert_not_decoded(decoder.decode(gzip.compress(data[:-1])))
+
+def test_iter_records_truncated_compressed():
+    data = b"".join(b"[%d]\n" % i for i in range(10000))
+    config = JsonDecoderConfig()
+    config.compression = InputCompression.GZIP
+    decoder = JsonDecoder(config)
+    results = list(decoder.iter_records(gzip.compress(data)[:-10]))
+    assert_not_decoded(results[-1])
+    assert [result.parsed for result in results[:-1]] == [[i] for i in range(len(results) - 1)]
+
+
+def test_iterparse_truncated_compressed():
+    data = json.dumps(list(range(10000))).encode("utf-8")
+    config = JsonDecoderConfig()
+    config.compression = InputCompression.GZIP
+    decoder = JsonDecoder(config)
+    parser = decoder.iterparse(gzip.compress(data)[:-10])
+    events = list(parser)
+    assert len(parser.error_message) != 0
+    assert events[:2] == [("", "start_array", None), ("item", "number", 0)]
+
+
 def test_decode_invalid_json_pointer():
     data = {"key1": 1, "key2": [2, 3], "key3": "value"}
     config = JsonDecoderConfig()
@@ -105,3 +444,121 @@ def test_decode_invalid_json_pointer():
     decoder = JsonDecoder(config)
     decoding_result = decoder.decode(bytes(json.dumps(data), "utf-8"))
     assert_not_decoded(decoding_result, JsonDecoderError.BadDepth)
+
+
+def test_iter_records_invalid_records():
+    lines = [b"{\"key\": 1}", b"{\"key\": ", b"[1, 2]", b"{\"key\": 1, \"key\": 2}", b"3"]
+    data = b"\n".join(lines)
+    decoder = JsonDecoder(JsonDecoderConfig())
+    results = list(decoder.iter_records(data))
+    assert len(results) == len(lines)
+    assert results[0].parsed == {"key": 1}
+    assert_not_decoded(results[1])
+    line_start = len(lines[0]) + 1
+    assert line_start <= results[1].cursor_position <= line_start + len(lines[1]) + 1
+    assert results[2].parsed == [1, 2]
+    assert_not_decoded(results[3], JsonDecoderError.DuplicateMapKey + "key")
+    assert results[4].parsed == 3
+
+
+def test_iter_records_non_existent_file():
+    decoder = JsonDecoder(JsonDecoderConfig())
+    results = list(decoder.iter_records("random123"))
+    assert len(results) == 1
+    assert_not_decoded(results[0], JsonDecoderError.FailedToOpenFile)
+
+
+def test_decode_many_invalid_bytes():
+    data = [b"[1, 2]", b"+(=)", b"{\"val\": 1, \"val\": 2}", b"[[1, 2]", b"{\"key\": \"value\"}"]
+    decoder = JsonDecoder(JsonDecoderConfig())
+    results = decoder.decode_many(data, num_threads=2)
+    assert len(results) == len(data)
+    assert results[0].parsed == [1, 2]
+    assert results[4].parsed == {"key": "value"}
+    for result, encoded in zip(results[1:4], data[1:4]):
+        decoding_result = decoder.decode(encoded)
+        assert_not_decoded(result, decoding_result.error_message)
+
+
+def test_decode_many_invalid_bytes_decoded_once():
+    data = [b"+(=)", b"[[1, 2]", b"{\"val\": 1, \"val\": 2}"]
+    config = JsonDecoderConfig()
+    config.collect_stats = True
+    decoder = JsonDecoder(config)
+    results = decoder.decode_many(data, num_threads=2)
+    # Only the duplicate map key, reported by the callbacks, needs a regular
+    # decoding to get the same result as decode
+    assert list(results[0].stats["phases"]) == ["parse", "python_conversion"]
+    assert list(results[1].stats["phases"]) == ["parse", "python_conversion"]
+    assert list(results[2].stats["phases"]) == ["decode"]
+    for result, encoded in zip(results, data):
+        decoding_result = decoder.decode(encoded)
+        assert_not_decoded(result, decoding_result.error_message)
+        assert result.cursor_position == decoding_result.cursor_position
+        assert result.cursor_position == decoding_result.cursor_position
+
+
+@pytest.mark.parametrize("encoded", [
+    b"[" + b"[1, 2], " * 40000 + b"[3, +], [4]]",
+    b"[" + b"[1, 2], " * 40000 + b"]",
+    b"[" + b"[1, 2], " * 40000 + b"[3]",
+    b"{" + b"".join(b"\"key%d\": %d, " % (i, i) for i in range(40000)) + b"\"key1\": 1}",
+])
+def test_decode_parallel_invalid_bytes(encoded):
+    decoder = JsonDecoder(JsonDecoderConfig())
+    result = decoder.decode_parallel(encoded, num_threads=4)
+    decoding_result = decoder.decode(encoded)
+    assert result.error_message == decoding_result.error_message
+    assert result.cursor_position == decoding_result.cursor_position
+    assert result.parsed == decoding_result.parsed
+
+
+def test_decode_invalid_json_pointers():
+    config = JsonDecoderConfig()
+    config.json_pointers = ["/key1", "key2"]
+    decoder = JsonDecoder(config)
+    decoding_result = decoder.decode(b"{\"key1\": 1}")
+    assert_not_decoded(decoding_result, JsonDecoderError.BadJsonPointer)
+
+
+@pytest.mark.parametrize("param", [
+    (b"{}", {}, JsonDecoderError.NonRecordArray),
+    (b"[1]", {}, JsonDecoderError.NonRecordArray),
+    (b'[{"a": 1, "a": 2}]', {}, JsonDecoderError.DuplicateMapKey + "a"),
+    (b'[{"a": 1}, {"a": "x"}]', {"a": JsonColumnType.INT64}, JsonDecoderError.BadColumnType + "a"),
+    (b'[{"a": [1]}]', {"a": JsonColumnType.STRING}, JsonDecoderError.BadColumnType + "a"),
+])
+def test_decode_columnar_invalid_records(param):
+    decoder = JsonDecoder(JsonDecoderConfig())
+    decoding_result = decoder.decode_columnar(param[0], param[1])
+    assert_not_decoded(decoding_result, param[2])
+
+
+@pytest.mark.parametrize("data", [
+    b"+(=)",
+    b"\"\xff\"",
+    b"{\"val\":" + b"1"*130 + b"}",
+    b"{\"a\": 1, \"b\": {\"a\": 2}, \"a\": 3}",
+])
+def test_validate_invalid_bytes(data):
+    decoder = JsonDecoder(JsonDecoderConfig())
+    validation_result = decoder.validate(data)
+    decoding_result = decoder.decode(data)
+    assert len(validation_result.error_message) != 0
+    assert validation_result.error_message == decoding_result.error_message
+    assert validation_result.cursor_position == decoding_result.cursor_position
+
+
+def test_iterparse_invalid_bytes():
+    decoder = JsonDecoder(JsonDecoderConfig())
+    parser = decoder.iterparse(b'{"a": [1, }')
+    assert list(parser) == [("", "start_map", None), ("", "map_key", "a"), ("a", "start_array", None),
+                            ("a.item", "number", 1)]
+    assert parser.error_message == JsonDecoderError.BadInput
+
+
+def test_iterparse_non_existent_file():
+    decoder = JsonDecoder(JsonDecoderConfig())
+    parser = decoder.iterparse("random123")
+    assert list(parser) == []
+    assert parser.error_message == JsonDecoderError.FailedToOpenFile
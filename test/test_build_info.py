@@ -0,0 +1,50 @@
+import platform
+import sys
+
+import pytest
+
+import pywuffs
+
+SIMD_PATHS = ["x86_sse42", "x86_avx2", "arm_neon", "arm_crc32"]
+IS_X86_64 = platform.machine().lower() in ("x86_64", "amd64") and sys.maxsize > 2 ** 32
+
+
+def test_build_info():
+    info = pywuffs.build_info()
+    assert info["wuffs_version"].startswith("0.4.0")
+    assert len(info["compiler"]) != 0
+    compiled = info["compiled_simd_paths"]
+    cpu_features = info["cpu_features"]
+    assert set(compiled) <= set(SIMD_PATHS)
+    assert info["active_simd_paths"] == [path for path in compiled if cpu_features.get(path, False)]
+    if not IS_X86_64:
+        # The x86 SIMD code paths are only compiled for x86-64
+        assert not any(path.startswith("x86_") for path in compiled)
+    elif not info["compiler"].startswith("MSVC"):
+        assert "x86_sse42" in compiled
+        assert "x86_avx2" in compiled
+
+
+@pytest.mark.skipif(not IS_X86_64 or not sys.platform.startswith("linux"), reason="needs /proc/cpuinfo on x86-64")
+def test_build_info_cpu_features():
+    with open("/proc/cpuinfo") as f:
+        flags = next(line for line in f if line.startswith("flags")).split()
+    cpu_features = pywuffs.build_info()["cpu_features"]
+    # Wuffs' x86-64-v2 and x86-64-v3 levels also need PCLMUL and POPCNT
+    has_sse42 = all(flag in flags for flag in ["sse4_2", "pclmulqdq", "popcnt"])
+    assert cpu_features["x86_sse42"] == has_sse42
+    assert cpu_features["x86_avx2"] == (has_sse42 and "avx2" in flags)
+    assert cpu_features["x86_bmi2"] == ("bmi2" in flags)
+
+
+def test_build_info_codecs():
+    codecs = pywuffs.build_info()["codecs"]
+    assert len(codecs) != 0
+    # Only the compiled codecs are exposed
+    if hasattr(pywuffs, "ImageDecoderType"):
+        for name in pywuffs.ImageDecoderType.__members__:
+            assert name.lower() in codecs
+    for name in ["crc32", "adler32", "xxhash32", "xxhash64", "sha256"]:
+        assert hasattr(pywuffs.hash, name) == (name in codecs)
+    assert hasattr(pywuffs.aux, "JsonDecoder") == ("json" in codecs)
+    assert hasattr(pywuffs.aux, "CborDecoder") == ("cbor" in codecs)
@@ -0,0 +1,81 @@
+import os
+import threading
+
+import pywuffs
+from pywuffs.aux import *
+
+PNG_PATH = os.path.join(os.path.dirname(os.path.realpath(__file__)), "images", "lena.png")
+NUM_THREADS = 4
+
+
+def decode_all(png_data):
+    ImageDecoder(ImageDecoderConfig()).decode(png_data)
+    ImageDecoder(ImageDecoderConfig()).decode(b"123")
+    JsonDecoder(JsonDecoderConfig()).decode(b"[1, 2]")
+    JsonDecoder(JsonDecoderConfig()).decode(b"[1,")
+
+
+def test_metrics():
+    with open(PNG_PATH, "rb") as f:
+        png_data = f.read()
+    pywuffs.reset_metrics()
+    # The counters of the exited threads must be kept as well
+    threads = [threading.Thread(target=decode_all, args=(png_data,)) for _ in range(NUM_THREADS)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    decode_all(png_data)
+    num_decodes = NUM_THREADS + 1
+    metrics = pywuffs.metrics()
+    png = metrics["decoders"]["PNG"]
+    assert png["count"] == num_decodes
+    assert png["errors"] == 0
+    assert png["input_bytes"] == num_decodes * len(png_data)
+    assert png["total_seconds"] > 0
+    assert sum(png["latency_histogram"]) == num_decodes
+    unknown = metrics["decoders"]["UNKNOWN"]
+    assert unknown["count"] == unknown["errors"] == num_decodes
+    assert metrics["errors"][ImageDecoderError.UnsupportedImageFormat] == num_decodes
+    assert metrics["decoders"]["JSON"]["count"] == 2 * num_decodes
+    assert metrics["decoders"]["JSON"]["errors"] == num_decodes
+    pywuffs.reset_metrics()
+    assert pywuffs.metrics() == {"decoders": {}, "errors": {}}
+
+
+def test_metrics_read_errors():
+    class FailingFile:
+        def __init__(self, i):
+            self.i = i
+
+        def readinto(self, buffer):
+            raise OSError("connection to peer %d reset" % self.i)
+
+    pywuffs.reset_metrics()
+    num_decodes = 10
+    for i in range(num_decodes):
+        decoding_result = ImageDecoder(ImageDecoderConfig()).decode(FailingFile(i))
+        assert decoding_result.error_message.startswith(ImageDecoderError.FailedToReadFile)
+        assert ("peer %d" % i) in decoding_result.error_message
+        validation_result = JsonDecoder(JsonDecoderConfig()).validate(FailingFile(i))
+        assert validation_result.error_message.startswith(JsonDecoderError.FailedToReadFile)
+        assert ("peer %d" % i) in validation_result.error_message
+    # The exception texts must not end up in the error keys
+    assert pywuffs.metrics()["errors"] == {
+        ImageDecoderError.FailedToReadFile: num_decodes,
+        JsonDecoderError.FailedToReadFile: num_decodes,
+    }
+    pywuffs.reset_metrics()
+
+
+def test_metrics_duplicate_map_keys():
+    pywuffs.reset_metrics()
+    decoder = JsonDecoder(JsonDecoderConfig())
+    data = [b"{\"key1\": 1, \"key1\": 2}", b"{\"key2\": 1, \"key2\": 2}"]
+    for encoded in data:
+        assert decoder.decode(encoded).error_message.startswith(JsonDecoderError.DuplicateMapKey)
+    for result in decoder.decode_many(data, num_threads=2):
+        assert result.error_message.startswith(JsonDecoderError.DuplicateMapKey)
+    # The map keys from the input must not end up in the error keys
+    assert pywuffs.metrics()["errors"] == {JsonDecoderError.DuplicateMapKey: 2 * len(data)}
+    pywuffs.reset_metrics()